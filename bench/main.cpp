@@ -0,0 +1,282 @@
+#include <chrono>
+#include <cstdio>
+#include "core/unique_ptr.hpp"
+#include "core/list.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/render_pass.hpp"
+#include "graphics/api/framebuffer.hpp"
+#include "graphics/api/semaphore.hpp"
+#include "graphics/api/fence.hpp"
+#include "graphics/api/gpu.hpp"
+#include "graphics/api/texture.hpp"
+#include "2d/rect_renderer.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "2d/draw_queue.hpp"
+#include "2d/renderer_2d.hpp"
+#include "null_backend.hpp"
+
+// Headless CPU benchmark, every scenario draws the same frame several times
+// against the null backend and reports the average per frame
+
+static constexpr size_t WarmupFrames   = 3;
+static constexpr size_t MeasuredFrames = 20;
+static constexpr Vector2u FramebufferSize = {1920, 1080};
+
+static constexpr size_t RectsCount     = 100000;
+static constexpr size_t CirclesCount   = 200000;
+static constexpr size_t PolylinesCount = 200;
+static constexpr size_t PolylineLength = 1000;
+static constexpr size_t TexturesCount  = 24;
+
+struct Context{
+    UniquePtr<RenderPass> Pass;
+    UniquePtr<Framebuffer> Target;
+    UniquePtr<CommandPool> Pool;
+    CommandBuffer *CmdBuffer = nullptr;
+    Semaphore Wait;
+    Semaphore Signal;
+    List<UniquePtr<Texture2D>> Textures;
+};
+
+static u32 s_Seed = 0x2D2D2D2D;
+
+static u32 Random(){
+    // xorshift32, results should be the same on every run
+    s_Seed ^= s_Seed << 13;
+    s_Seed ^= s_Seed >> 17;
+    s_Seed ^= s_Seed << 5;
+    return s_Seed;
+}
+
+static float RandomFloat(float min, float max){
+    return min + (Random() & 0xFFFF) / 65535.f * (max - min);
+}
+
+static Color RandomColor(){
+    return Color(RandomFloat(0.f, 1.f), RandomFloat(0.f, 1.f), RandomFloat(0.f, 1.f), 1.f);
+}
+
+template<typename FrameType>
+static void RunScenario(const char *name, size_t primitives, FrameType &&frame){
+    for(size_t i = 0; i<WarmupFrames; i++)
+        frame();
+
+    NullBackend::ResetStats();
+
+    const auto begin = std::chrono::steady_clock::now();
+    for(size_t i = 0; i<MeasuredFrames; i++)
+        frame();
+    const auto end = std::chrono::steady_clock::now();
+
+    const NullBackendStats &stats = NullBackend::Stats();
+    const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    const double frames = (double)MeasuredFrames;
+
+    std::printf("%-28s %10zu %10.2f %10.3f %14.0f %8.1f %8.1f %8.1f %8.1f\n",
+        name, primitives,
+        ns / (frames * primitives),
+        ns / frames / 1000000.0,
+        stats.BytesUploaded / frames,
+        stats.DrawCalls / frames,
+        stats.Submits / frames,
+        stats.DescriptorWrites / frames,
+        stats.BufferAllocations / frames
+    );
+}
+
+static void BenchRects(Context &context, RectRenderer::TexturingMode mode, const char *name){
+    RectRenderer renderer(context.Pass.Get(), DefaultFramesInFlight, mode);
+
+    List<Vector2f> positions;
+    List<Vector2f> sizes;
+    List<Color> colors;
+    List<Texture2D *> textures;
+    for(size_t i = 0; i<RectsCount; i++){
+        positions.Add({RandomFloat(0.f, FramebufferSize.x), RandomFloat(0.f, FramebufferSize.y)});
+        sizes.Add({RandomFloat(2.f, 40.f), RandomFloat(2.f, 40.f)});
+        colors.Add(RandomColor());
+        textures.Add(context.Textures[Random() % context.Textures.Size()].Get());
+    }
+
+    RunScenario(name, RectsCount, [&](){
+        for(size_t i = 0; i<RectsCount; i++)
+            renderer.DrawRect(positions[i], sizes[i], colors[i], textures[i]);
+
+        context.CmdBuffer->Begin();
+        renderer.CmdRender(context.CmdBuffer, context.Target.Get());
+        context.CmdBuffer->End();
+        GPU::Execute(context.CmdBuffer, context.Wait, context.Signal, Fence());
+    });
+}
+
+static void BenchRectsBulk(Context &context){
+    RectRenderer renderer(context.Pass.Get());
+
+    List<Vector2f> positions;
+    List<Vector2f> sizes;
+    List<float> angles;
+    List<Color> colors;
+    for(size_t i = 0; i<RectsCount; i++){
+        positions.Add({RandomFloat(0.f, FramebufferSize.x), RandomFloat(0.f, FramebufferSize.y)});
+        sizes.Add({RandomFloat(2.f, 40.f), RandomFloat(2.f, 40.f)});
+        angles.Add(RandomFloat(0.f, 6.28f));
+        colors.Add(RandomColor());
+    }
+
+    RunScenario("rects_bulk_rotated", RectsCount, [&](){
+        renderer.DrawRects({positions.Data(), positions.Size()}, {sizes.Data(), sizes.Size()}, {angles.Data(), angles.Size()}, {colors.Data(), colors.Size()});
+
+        context.CmdBuffer->Begin();
+        renderer.CmdRender(context.CmdBuffer, context.Target.Get());
+        context.CmdBuffer->End();
+        GPU::Execute(context.CmdBuffer, context.Wait, context.Signal, Fence());
+    });
+}
+
+static void BenchCircles(Context &context){
+    CircleRenderer renderer(context.Pass.Get());
+
+    List<Vector2s> centers;
+    List<float> radii;
+    List<Color> colors;
+    for(size_t i = 0; i<CirclesCount; i++){
+        centers.Add({(s32)(Random() % FramebufferSize.x), (s32)(Random() % FramebufferSize.y)});
+        radii.Add(RandomFloat(1.f, 20.f));
+        colors.Add(RandomColor());
+    }
+
+    RunScenario("circles", CirclesCount, [&](){
+        renderer.BeginDrawing(&context.Wait, context.Target.Get());
+        for(size_t i = 0; i<CirclesCount; i++)
+            renderer.DrawCircle(centers[i], radii[i], colors[i]);
+        renderer.EndDrawing(&context.Signal);
+    });
+}
+
+static void BenchLines(Context &context, LineRenderer::LineMode mode, const char *name){
+    LineRenderer renderer(context.Pass.Get(), DefaultFramesInFlight, mode);
+
+    // random walks, so segments are short and mostly on screen like plotted data
+    List<Vector2s> points;
+    for(size_t i = 0; i<PolylinesCount; i++){
+        Vector2s point = {(s32)(Random() % FramebufferSize.x), (s32)(Random() % FramebufferSize.y)};
+        for(size_t j = 0; j<PolylineLength; j++){
+            point.x = (s32)((point.x + Random() % 9 - 4 + FramebufferSize.x) % FramebufferSize.x);
+            point.y = (s32)((point.y + Random() % 9 - 4 + FramebufferSize.y) % FramebufferSize.y);
+            points.Add(point);
+        }
+    }
+
+    RunScenario(name, PolylinesCount * (PolylineLength - 1), [&](){
+        renderer.BeginDrawing(&context.Wait, context.Target.Get());
+        for(size_t i = 0; i<PolylinesCount; i++){
+            ConstSpan<Vector2s> polyline(points.Data() + i * PolylineLength, PolylineLength);
+            renderer.DrawLines(polyline, Color::Green, 1 + i % 4);
+        }
+        renderer.EndDrawing(&context.Signal);
+    });
+}
+
+// live plot, every frame appends a block of points to a ring that wraps a few times per run
+static void BenchStreaming(Context &context){
+    constexpr size_t Capacity = PolylinesCount * PolylineLength / 4;
+    constexpr size_t AppendedPerFrame = Capacity / 8 + 1;
+
+    LineRenderer renderer(context.Pass.Get());
+    LineRenderer::StreamingPolyline polyline(Capacity, 2);
+
+    List<Vector2s> points;
+    for(size_t i = 0; i<AppendedPerFrame; i++)
+        points.Add({(s32)(i % FramebufferSize.x), (s32)(Random() % FramebufferSize.y)});
+
+    RunScenario("lines_streaming", Capacity - 1, [&](){
+        polyline.Append({points.Data(), points.Size()}, Color::Green);
+
+        renderer.BeginDrawing(&context.Wait, context.Target.Get());
+        renderer.DrawStreaming(polyline);
+        renderer.EndDrawing(&context.Signal);
+    });
+}
+
+static void BenchDrawQueue(Context &context){
+    DrawQueue queue(context.Pass.Get());
+
+    constexpr size_t Count = RectsCount / 2;
+
+    List<Vector2f> positions;
+    List<Texture2D *> textures;
+    for(size_t i = 0; i<Count; i++){
+        positions.Add({RandomFloat(0.f, FramebufferSize.x), RandomFloat(0.f, FramebufferSize.y)});
+        textures.Add(context.Textures[Random() % context.Textures.Size()].Get());
+    }
+
+    RunScenario("draw_queue_mixed", Count * 2, [&](){
+        for(size_t i = 0; i<Count; i++){
+            const DrawQueue::Layer layer = (DrawQueue::Layer)(i % 8);
+            queue.DrawRect(layer, positions[i], {16.f, 16.f}, {0.f, 0.f}, 0.f, Color::White, textures[i]);
+            queue.DrawCircle(layer, positions[i], 8.f, Color::Red);
+        }
+
+        context.CmdBuffer->Begin();
+        queue.CmdRender(context.CmdBuffer, context.Target.Get());
+        context.CmdBuffer->End();
+        GPU::Execute(context.CmdBuffer, context.Wait, context.Signal, Fence());
+    });
+}
+
+// circles and lines recorded into one Renderer2D frame, a single submit for both
+static void BenchRenderer2D(Context &context){
+    Renderer2D context_2d;
+    CircleRenderer circles(context.Pass.Get());
+    LineRenderer lines(context.Pass.Get(), DefaultFramesInFlight, LineRenderer::LineMode::Expanded);
+
+    context_2d.Attach(&circles);
+    context_2d.Attach(&lines);
+
+    List<Vector2s> points;
+    List<float> radii;
+    List<Color> colors;
+    for(size_t i = 0; i<CirclesCount; i++){
+        points.Add({(s32)(Random() % FramebufferSize.x), (s32)(Random() % FramebufferSize.y)});
+        radii.Add(RandomFloat(1.f, 20.f));
+        colors.Add(RandomColor());
+    }
+
+    RunScenario("renderer_2d_circles_lines", CirclesCount * 2 - 1, [&](){
+        context_2d.BeginFrame();
+        for(size_t i = 0; i<CirclesCount; i++)
+            circles.DrawCircle(points[i], radii[i], colors[i]);
+        lines.DrawLines({points.Data(), points.Size()}, Color::Green, 2);
+        context_2d.EndFrame(&context.Wait, &context.Signal, context.Target.Get());
+    });
+
+    context_2d.Detach(&lines);
+    context_2d.Detach(&circles);
+}
+
+int main(){
+    Context context;
+    context.Pass        = NullBackend::CreateRenderPass();
+    context.Target      = NullBackend::CreateFramebuffer(context.Pass.Get(), FramebufferSize);
+    context.Pool        = CommandPool::Create();
+    context.CmdBuffer   = context.Pool->Alloc();
+    for(size_t i = 0; i<TexturesCount; i++)
+        context.Textures.Add(Texture2D::Create(64, 64, TextureFormat::RGBA8, TextureUsageBits::Sampled | TextureUsageBits::TransferDst));
+
+    std::printf("%-28s %10s %10s %10s %14s %8s %8s %8s %8s\n",
+        "scenario", "primitives", "ns/prim", "ms/frame", "bytes/frame", "draws", "submits", "writes", "allocs");
+
+    BenchRects(context, RectRenderer::TexturingMode::PerBatch, "rects_textured_per_batch");
+    BenchRects(context, RectRenderer::TexturingMode::Bindless, "rects_textured_bindless");
+    BenchRectsBulk(context);
+    BenchCircles(context);
+    BenchLines(context, LineRenderer::LineMode::Native,   "lines_native");
+    BenchLines(context, LineRenderer::LineMode::Expanded, "lines_expanded");
+    BenchStreaming(context);
+    BenchDrawQueue(context);
+    BenchRenderer2D(context);
+
+    context.Pool->Free(context.CmdBuffer);
+    return 0;
+}
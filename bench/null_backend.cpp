@@ -0,0 +1,242 @@
+#include "null_backend.hpp"
+#include "core/os/memory.hpp"
+#include "core/unique_ptr.hpp"
+#include "graphics/api/buffer.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/descriptor_set.hpp"
+#include "graphics/api/graphics_pipeline.hpp"
+#include "graphics/api/shader.hpp"
+#include "graphics/api/sampler.hpp"
+#include "graphics/api/texture.hpp"
+#include "graphics/api/render_pass.hpp"
+#include "graphics/api/framebuffer.hpp"
+#include "graphics/api/fence.hpp"
+#include "graphics/api/semaphore.hpp"
+#include "graphics/api/gpu.hpp"
+
+static NullBackendStats s_Stats;
+
+NullBackendStats &NullBackend::Stats(){
+    return s_Stats;
+}
+
+void NullBackend::ResetStats(){
+    s_Stats = {};
+}
+
+class NullBuffer: public Buffer{
+private:
+    UniquePtr<u8[]> m_Memory;
+    size_t m_Size = 0;
+public:
+    NullBuffer(size_t size):
+        m_Memory(new u8[size]),
+        m_Size(size)
+    {
+        s_Stats.BufferAllocations++;
+    }
+
+    void Copy(const void *data, size_t size, size_t offset)override{
+        Memory::Copy(data, m_Memory.Get() + offset, size);
+        s_Stats.BytesUploaded += size;
+    }
+
+    void *Map()override{
+        return m_Memory.Get();
+    }
+
+    size_t Size()const override{
+        return m_Size;
+    }
+};
+
+Buffer *Buffer::Create(size_t size, BufferMemoryType, BufferUsage){
+    return new NullBuffer(size);
+}
+
+class NullCommandBuffer: public CommandBuffer{
+public:
+    void Begin()override{}
+
+    void End()override{}
+
+    void Reset()override{}
+
+    void Copy(const Buffer *, Buffer *, size_t size, size_t, size_t)override{
+        s_Stats.BytesUploaded += size;
+    }
+
+    void Copy(const void *, size_t size, Buffer *)override{
+        s_Stats.BytesUploaded += size;
+    }
+
+    void Bind(const GraphicsPipeline *)override{
+        s_Stats.PipelineBinds++;
+    }
+
+    void Bind(const DescriptorSet *)override{}
+
+    void BindVertexBuffer(const Buffer *)override{}
+
+    void BindIndexBuffer(const Buffer *, IndicesType)override{}
+
+    void SetScissor(float, float, float, float)override{}
+
+    void SetViewport(float, float, float, float)override{}
+
+    void SetLineWidth(float)override{}
+
+    void BeginRenderPass(const RenderPass *, const Framebuffer *)override{
+        s_Stats.RenderPasses++;
+    }
+
+    void EndRenderPass()override{}
+
+    void Draw(u32, u32)override{
+        s_Stats.DrawCalls++;
+    }
+
+    void DrawIndexed(u32, u32)override{
+        s_Stats.DrawCalls++;
+    }
+};
+
+class NullCommandPool: public CommandPool{
+public:
+    CommandBuffer *Alloc()override{
+        return new NullCommandBuffer();
+    }
+
+    void Free(CommandBuffer *buffer)override{
+        delete buffer;
+    }
+};
+
+CommandPool *CommandPool::Create(){
+    return new NullCommandPool();
+}
+
+class NullDescriptorSet: public DescriptorSet{
+public:
+    void UpdateUniformBinding(size_t, size_t, const Buffer *)override{
+        s_Stats.DescriptorWrites++;
+    }
+
+    void UpdateStorageBufferBinding(size_t, size_t, const Buffer *)override{
+        s_Stats.DescriptorWrites++;
+    }
+
+    void UpdateTextureBinding(size_t, size_t, const Texture2D *, const Sampler *)override{
+        s_Stats.DescriptorWrites++;
+    }
+};
+
+class NullDescriptorSetLayout: public DescriptorSetLayout{};
+
+DescriptorSetLayout *DescriptorSetLayout::Create(ConstSpan<ShaderBinding>){
+    return new NullDescriptorSetLayout();
+}
+
+class NullDescriptorSetPool: public DescriptorSetPool{
+public:
+    DescriptorSet *Alloc()override{
+        return new NullDescriptorSet();
+    }
+
+    void Free(DescriptorSet *set)override{
+        delete set;
+    }
+};
+
+DescriptorSetPool *DescriptorSetPool::Create(const DescriptorSetPoolProperties &){
+    return new NullDescriptorSetPool();
+}
+
+class NullShader: public Shader{};
+
+Shader *Shader::Create(ShaderStageBits::Value, ConstSpan<char>){
+    return new NullShader();
+}
+
+class NullGraphicsPipeline: public GraphicsPipeline{};
+
+GraphicsPipeline *GraphicsPipeline::Create(const GraphicsPipelineProperties &){
+    return new NullGraphicsPipeline();
+}
+
+class NullSampler: public Sampler{};
+
+Sampler *Sampler::Create(const SamplerProperties &){
+    return new NullSampler();
+}
+
+class NullTexture2D: public Texture2D{
+public:
+    void Copy(const void *, size_t size)override{
+        s_Stats.BytesUploaded += size;
+    }
+};
+
+Texture2D *Texture2D::Create(u32, u32, TextureFormat, TextureUsage){
+    return new NullTexture2D();
+}
+
+Texture2D *Texture2D::White(){
+    static NullTexture2D s_White;
+    return &s_White;
+}
+
+class NullRenderPass: public RenderPass{};
+
+RenderPass *NullBackend::CreateRenderPass(){
+    return new NullRenderPass();
+}
+
+class NullFramebuffer: public Framebuffer{
+private:
+    Vector2u m_Size;
+public:
+    NullFramebuffer(Vector2u size):
+        m_Size(size)
+    {}
+
+    Vector2u Size()const override{
+        return m_Size;
+    }
+};
+
+Framebuffer *NullBackend::CreateFramebuffer(const RenderPass *, Vector2u size){
+    return new NullFramebuffer(size);
+}
+
+// nothing is ever in flight, so fences are always signaled
+Fence::Fence() = default;
+
+Fence::~Fence() = default;
+
+void Fence::Signal(){}
+
+void Fence::WaitFor()const{}
+
+void Fence::WaitAndReset(){}
+
+bool Fence::IsSignaled()const{
+    return true;
+}
+
+Semaphore::Semaphore() = default;
+
+Semaphore::~Semaphore() = default;
+
+// the usual Vulkan limit of desktop devices, so bindless table is sized like it would be there
+u32 GPU::MaxTexturesPerStage(){
+    return 4096;
+}
+
+void GPU::Execute(const CommandBuffer *, const Semaphore &, const Semaphore &, const Fence &){
+    s_Stats.Submits++;
+}
+
+void GPU::Execute(const CommandBuffer *, const Fence &){
+    s_Stats.Submits++;
+}
@@ -0,0 +1,37 @@
+#ifndef STRAITX_2D_BENCH_NULL_BACKEND_HPP
+#define STRAITX_2D_BENCH_NULL_BACKEND_HPP
+
+#include "core/types.hpp"
+#include "core/math/vector2.hpp"
+
+class RenderPass;
+class Framebuffer;
+
+// Graphics API implementation that talks to no driver, it only keeps buffer memory
+// in RAM and counts what would have been sent to the GPU.
+// It is the only backend of the headless StraitXBase the benchmark links against, see CMakeLists.txt
+struct NullBackendStats{
+    // bytes written into GPU visible memory, either directly or by command buffer copies
+    u64 BytesUploaded     = 0;
+    u64 BufferAllocations = 0;
+    u64 DrawCalls         = 0;
+    u64 PipelineBinds     = 0;
+    u64 DescriptorWrites  = 0;
+    u64 RenderPasses      = 0;
+    u64 Submits           = 0;
+};
+
+namespace NullBackend{
+
+NullBackendStats &Stats();
+
+void ResetStats();
+
+// both are owned by the caller
+RenderPass *CreateRenderPass();
+
+Framebuffer *CreateFramebuffer(const RenderPass *pass, Vector2u size);
+
+}//namespace NullBackend::
+
+#endif//STRAITX_2D_BENCH_NULL_BACKEND_HPP
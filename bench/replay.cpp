@@ -0,0 +1,157 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "core/unique_ptr.hpp"
+#include "core/list.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/render_pass.hpp"
+#include "graphics/api/framebuffer.hpp"
+#include "graphics/api/semaphore.hpp"
+#include "graphics/api/fence.hpp"
+#include "graphics/api/gpu.hpp"
+#include "graphics/api/texture.hpp"
+#include "2d/rect_renderer.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "2d/draw_capture.hpp"
+#include "null_backend.hpp"
+
+// Replays a capture written by DrawCapture against the null backend, as fast as possible.
+// Usage: StraitX2D_replay <capture file> [passes]
+
+static constexpr size_t TexturesCount = 256;
+
+class MappedFile{
+private:
+    void *m_Data = nullptr;
+    size_t m_Size = 0;
+public:
+    MappedFile(const char *path){
+        int fd = open(path, O_RDONLY);
+        if(fd < 0)
+            return;
+
+        struct stat info;
+        if(fstat(fd, &info) == 0 && info.st_size > 0){
+            void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(data != MAP_FAILED){
+                m_Data = data;
+                m_Size = (size_t)info.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile(){
+        if(m_Data)
+            munmap(m_Data, m_Size);
+    }
+
+    const void *Data()const{
+        return m_Data;
+    }
+
+    size_t Size()const{
+        return m_Size;
+    }
+};
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::fprintf(stderr, "Usage: %s <capture file> [passes]\n", argv[0]);
+        return 1;
+    }
+
+    const size_t passes = argc > 2 ? (size_t)std::strtoul(argv[2], nullptr, 10) : 10;
+
+    MappedFile file(argv[1]);
+    DrawCaptureReader reader(file.Data(), file.Size());
+
+    if(!reader.IsValid()){
+        std::fprintf(stderr, "'%s' is not a capture of version %u\n", argv[1], DrawCapture::Version);
+        return 1;
+    }
+
+    UniquePtr<RenderPass> pass = NullBackend::CreateRenderPass();
+    UniquePtr<CommandPool> pool = CommandPool::Create();
+    CommandBuffer *cmd_buffer = pool->Alloc();
+    Semaphore wait, signal;
+
+    List<UniquePtr<Texture2D>> textures;
+    List<Texture2D *> texture_pointers;
+    for(size_t i = 0; i<TexturesCount; i++){
+        textures.Add(Texture2D::Create(64, 64, TextureFormat::RGBA8, TextureUsageBits::Sampled | TextureUsageBits::TransferDst));
+        texture_pointers.Add(textures.Last().Get());
+    }
+
+    // captured frames may have different sizes, culling depends on them
+    std::map<u64, UniquePtr<Framebuffer>> framebuffers;
+    auto framebuffer_of = [&](Vector2u size)->const Framebuffer *{
+        UniquePtr<Framebuffer> &framebuffer = framebuffers[(u64)size.x << 32 | size.y];
+        if(!framebuffer)
+            framebuffer = NullBackend::CreateFramebuffer(pass.Get(), size);
+        return framebuffer.Get();
+    };
+
+    RectRenderer rects(pass.Get());
+    CircleRenderer circles(pass.Get());
+    LineRenderer lines(pass.Get());
+
+    DrawCaptureTargets targets;
+    targets.Rects = &rects;
+    targets.Circles = &circles;
+    targets.Lines = &lines;
+    targets.CmdBuffer = cmd_buffer;
+    targets.WaitSemaphore = &wait;
+    targets.SignalSemaphore = &signal;
+    targets.Textures = {texture_pointers.Data(), texture_pointers.Size()};
+
+    u64 commands = 0;
+    u64 rect_frames = 0;
+
+    const auto begin = std::chrono::steady_clock::now();
+    for(size_t i = 0; i<passes; i++){
+        reader.Rewind();
+
+        DrawCaptureCommand command;
+        while(reader.Next(command)){
+            commands++;
+
+            if(command.FramebufferSize.x && command.FramebufferSize.y)
+                targets.Target = framebuffer_of(command.FramebufferSize);
+
+            if(command.Type == DrawCommandType::RectRender){
+                cmd_buffer->Begin();
+                DrawCaptureReader::Replay(command, targets);
+                cmd_buffer->End();
+                GPU::Execute(cmd_buffer, wait, signal, Fence());
+                rect_frames++;
+            }else{
+                DrawCaptureReader::Replay(command, targets);
+            }
+
+            command = {};
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const NullBackendStats &stats = NullBackend::Stats();
+    const double ms = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1000000.0;
+
+    std::printf("passes:            %zu\n", passes);
+    std::printf("commands:          %llu\n", (unsigned long long)commands);
+    std::printf("rect frames:       %llu\n", (unsigned long long)rect_frames);
+    std::printf("ms/pass:           %.3f\n", ms / passes);
+    std::printf("bytes uploaded:    %llu\n", (unsigned long long)stats.BytesUploaded);
+    std::printf("draw calls:        %llu\n", (unsigned long long)stats.DrawCalls);
+    std::printf("submits:           %llu\n", (unsigned long long)stats.Submits);
+    std::printf("descriptor writes: %llu\n", (unsigned long long)stats.DescriptorWrites);
+
+    pool->Free(cmd_buffer);
+    return 0;
+}
@@ -0,0 +1,24 @@
+# Compiles one embedded shader into a header with SPIR-V words, run as
+# cmake -DGLSLANG=<path> -DINPUT=<file.stage.glsl> -DSTAGE=<vert|frag> -DVARIABLE=<name> -DOUTPUT=<file.spv.h> -P compile_shader.cmake
+# Embedded files are raw string literals without a version, the engine adds its prelude at
+# runtime, so the same is done here before handing the source to glslang
+
+file(READ ${INPUT} SOURCE)
+
+string(REGEX REPLACE "^[ \t\r\n]*R\"\\(" "" SOURCE "${SOURCE}")
+string(REGEX REPLACE "\\)\"[ \t\r\n]*$" "" SOURCE "${SOURCE}")
+
+set(COMPLETE ${OUTPUT}.glsl)
+file(WRITE ${COMPLETE} "#version 450\n${SOURCE}")
+
+execute_process(
+    COMMAND ${GLSLANG} -V -S ${STAGE} --vn ${VARIABLE} -o ${OUTPUT} ${COMPLETE}
+    RESULT_VARIABLE RESULT
+    OUTPUT_VARIABLE LOG
+    ERROR_VARIABLE LOG
+)
+
+if(NOT RESULT EQUAL 0)
+    file(REMOVE ${OUTPUT})
+    message(FATAL_ERROR "StraitX2D: failed to compile ${INPUT}\n${LOG}")
+endif()
@@ -9,7 +9,8 @@
 #include "core/fixed_list.hpp"
 #include "core/noncopyable.hpp"
 #include "core/raw_var.hpp"
-#include "core/ring.hpp"
+#include "core/unique_ptr.hpp"
+#include "core/list.hpp"
 #include "graphics/color.hpp"
 #include "graphics/api/semaphore.hpp"
 #include "graphics/api/fence.hpp"
@@ -17,6 +18,10 @@
 
 #include "2d/common/semaphore_ring.hpp"
 #include "2d/common/viewport_parameters.hpp"
+#include "2d/common/frames_in_flight.hpp"
+#include "2d/common/culling.hpp"
+#include "2d/common/render_stats.hpp"
+#include "2d/common/view_uniform.hpp"
 
 class RenderPass;
 class Framebuffer;
@@ -24,34 +29,46 @@ class Shader;
 class GraphicsPipeline;
 class CommandPool;
 class CommandBuffer;
+class DrawCapture;
+class DrawRecorder;
 class Fence;
 class Buffer;
 class Texture2D;
+class Renderer2D;
 
 class CircleRenderer: public NonCopyable{
 public:
-    struct CircleVertex{
-        Vector2f a_Position;
+    // vertex shader pulls one record per circle and expands it into a quad
+    struct CircleInstance{
         Vector2f a_Center;
-        u32      a_Color;
         float    a_Radius;
+        u32      a_Color;
     };
 
-    static constexpr size_t MaxCirclesInBatch  = 60000;
-    static constexpr size_t MaxVerticesInBatch = MaxCirclesInBatch * 4;
-    static constexpr size_t MaxIndicesInBatch  = MaxCirclesInBatch * 6;
+    static constexpr size_t MaxCirclesInBatch  = 450000;
     static constexpr size_t MaxTexturesInSet   = MaxTexturesBindings;
-private:
-    struct MatricesUniform{
-        Matrix4f u_Projection{1.0f};
-    };
+    static constexpr size_t MaxViewports       = 4;
 
+    // Circles of a recorder uploaded once into VRAM in world space,
+    // current viewport is applied on the GPU every time geometry is drawn
+    class StaticGeometry: public NonCopyable{
+    private:
+        Buffer *m_Instances = nullptr;
+        size_t m_CirclesCount = 0;
+    public:
+        StaticGeometry(const DrawRecorder &recorder);
+
+        ~StaticGeometry();
+
+        friend class CircleRenderer;
+    };
+private:
     struct Batch{
-        Buffer *VerticesBuffer = nullptr;
-        Buffer *IndicesBuffer  = nullptr;
-        CircleVertex *Vertices = nullptr;
-        u32        *Indices  = nullptr;
+        Buffer *InstancesBuffer = nullptr;
+        CircleInstance *Instances = nullptr;
         size_t      SubmitedCirclesCount = 0;
+        // staging is copied here before drawing
+        Buffer *DeviceInstances = nullptr;
 
         Batch();
 
@@ -63,39 +80,98 @@ private:
             return SubmitedCirclesCount == MaxCirclesInBatch;
         }
     };
+
+    // each viewport is drawn from the same instances with its own uniform
+    struct ViewportSlot{
+        DescriptorSet *Set = nullptr;
+        Buffer *MatricesUniformBuffer = nullptr;
+        const Buffer *BoundInstances = nullptr;
+    };
+
+    // BeginDrawing/EndDrawing submissions, created on the first BeginDrawing,
+    // so a renderer attached to Renderer2D never has them
+    struct Submission{
+        CommandBuffer *CmdBuffer = nullptr;
+        Fence DrawingFence;
+
+        Array<ViewportSlot, MaxViewports> Viewports;
+    };
+
+    struct Frame{
+        // BeginDrawing/EndDrawing flush the first batch whenever it's full,
+        // Renderer2D frames go on in the next one and draw them all at once
+        List<Batch *> Batches;
+        size_t CurrentBatch = 0;
+
+        Frame();
+
+        ~Frame();
+
+        Batch &Staging(){
+            return *Batches[CurrentBatch];
+        }
+    };
+
+    // one draw call of the frame recorded into Renderer2D's command buffer
+    struct RecordedDraw{
+        const Buffer *Instances = nullptr;
+        size_t FirstCircle  = 0;
+        size_t CirclesCount = 0;
+    };
 private:
 
     //XXX: do something about allocation
     const RenderPass *m_FramebufferPass = nullptr;
     const Framebuffer *m_Framebuffer = nullptr;
     const DescriptorSetLayout *m_SetLayout = nullptr;
-    DescriptorSetPool         *m_SetPool   = nullptr;
-    DescriptorSet             *m_Set       = nullptr;
 
     Array<const Shader *, 2> m_Shaders = {nullptr, nullptr};
     GraphicsPipeline *m_Pipeline       = nullptr;
 
-    CommandPool   *m_CmdPool   = nullptr;
-    CommandBuffer *m_CmdBuffer = nullptr;
+    UniquePtr<Frame[]> m_Frames;
+    size_t m_FramesCount  = 0;
+    size_t m_CurrentFrame = 0;
 
-    Ring<Batch, 2> m_BatcheRings;
+    UniquePtr<CommandPool>       m_CmdPool;
+    UniquePtr<DescriptorSetPool> m_SetPool;
+    UniquePtr<Submission[]>      m_Submissions;
 
     SemaphoreRing m_SemaphoreRing;
 
-    MatricesUniform    m_MatricesUniform;
-    ViewportParameters m_CurrentViewport;
+    FixedList<ViewportParameters, MaxViewports> m_Viewports;
+    Array<ViewUniform, MaxViewports> m_ViewportUniforms;
+    Vector2f m_FramebufferSize = {0.f, 0.f};
+
+    // set while attached, drawing is recorded into the context's frame then
+    Renderer2D *m_Context = nullptr;
+    List<RecordedDraw> m_RecordedDraws;
+    // circles of the current batch already covered by recorded draws
+    size_t m_RecordedCircles = 0;
+
+    FramesInFlightStats m_FramesStats;
 
-    Fence m_DrawingFence;
+    CullingBounds        m_CullingBounds;
+    ViewportCullingStats m_CullingStats;
 
-    Buffer *m_VertexBuffer = nullptr;
-    Buffer *m_IndexBuffer  = nullptr;
-    Buffer *m_MatricesUniformBuffer = nullptr;
+    RenderStats m_Stats;
+    RenderStats m_LastFrameStats;
+
+    DrawCapture *m_Capture = nullptr;
+
+    List<const DrawRecorder *> m_Recorders;
 public:
-    CircleRenderer(const RenderPass *rp);
+    CircleRenderer(const RenderPass *rp, size_t frames_in_flight = DefaultFramesInFlight);
 
     ~CircleRenderer();
 
-    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport);
+    // Circles are uploaded once and drawn into every viewport with its own transform and scissor,
+    // a circle is culled only when it's outside of all of them.
+    // Not used when the renderer is attached to Renderer2D, which records and submits it at EndFrame
+    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, ConstSpan<ViewportParameters> viewports);
+
+    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport){
+        return BeginDrawing(wait_semaphore, framebuffer, ConstSpan<ViewportParameters>(&viewport, 1));
+    }
 
     Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer);
 
@@ -103,9 +179,95 @@ public:
 
     void DrawCircle(Vector2s center, float radius, Color color);
 
+    // All spans should be of the same size
+    void DrawCircles(ConstSpan<Vector2f> centers, ConstSpan<float> radii, ConstSpan<Color> colors);
+
+    // Flushes pending circles to keep drawing order and replays geometry with a single draw
+    void DrawStatic(const StaticGeometry &geometry);
+
     void Flush();
+
+    // Circles of submitted recorders are copied at EndDrawing, after directly drawn ones, in submission order
+    void Submit(const DrawRecorder *recorder);
+
+    // Renderer2D this is attached to should have the same number
+    size_t FramesInFlight()const{
+        return m_FramesCount;
+    }
+
+    const FramesInFlightStats &FramesStats()const{
+        return m_FramesStats;
+    }
+
+    void ResetFramesStats(){
+        m_FramesStats = {};
+    }
+
+    // Culling of frames recorded into Renderer2D, which are not culled until it's set.
+    // BeginDrawing sets it from its own viewports
+    void SetCullingViewport(Vector2u framebuffer_size, const ViewportParameters &viewport);
+
+    void DisableCulling(){
+        m_CullingBounds = {};
+    }
+
+    // circles entirely outside of the framebuffer are dropped before they reach a batch
+    const ViewportCullingStats &CullingStats()const{
+        return m_CullingStats;
+    }
+
+    void ResetCullingStats(){
+        m_CullingStats = {};
+    }
+
+    // stats of the last frame finished by EndDrawing
+    const RenderStats &LastFrameStats()const{
+        return m_LastFrameStats;
+    }
+
+    // Every following call is serialized into capture until it's reset with nullptr.
+    // Only BeginDrawing/EndDrawing frames are captured
+    void SetCapture(DrawCapture *capture){
+        m_Capture = capture;
+    }
 private:
+    // Renderer2D's path, draws everything recorded since the last one into its command buffer
+    void CmdRender(Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport);
+
+    void CreateSubmissions();
+
     void Flush(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore);
+
+    // flushes a full batch or, when recording into Renderer2D, goes on in the next one
+    Batch &BatchWithRoom();
+
+    // covers circles written into the current batch since the last call with a recorded draw
+    void RecordPendingCircles();
+
+    // staging is copied into instances first when it's not null
+    void SubmitDraw(const Buffer *staging, Buffer *instances, size_t circles_count, const Semaphore *wait_semaphore, const Semaphore *signal_semaphore);
+
+    Frame &CurrentFrame(){
+        return m_Frames[m_CurrentFrame];
+    }
+
+    Submission &CurrentSubmission(){
+        return m_Submissions[m_CurrentFrame];
+    }
+
+    void AdvanceFrame();
+
+    void MergeRecorders();
+
+    bool IsVisible(Vector2f center, float radius)const;
+
+    void PushCircles(const Vector2f *centers, const float *radii, const Color *colors, size_t count);
+
+    void CopyInstances(const CircleInstance *instances, size_t count);
+
+    static void WriteInstances(CircleInstance *instances, const Vector2f *centers, const float *radii, const u32 *colors, size_t count);
+
+    friend class Renderer2D;
 };
 
 #endif//STRAITX_2D_CIRCLE_RENDERER_HPP
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef STRAITX_2D_COMMON_CULLING_HPP
+#define STRAITX_2D_COMMON_CULLING_HPP
+
+#include "core/types.hpp"
+#include "core/math/vector2.hpp"
+#include "core/math/functions.hpp"
+
+struct ViewportCullingStats{
+    // primitives passed to Draw calls, segments for lines
+    u64 Submitted = 0;
+    // primitives dropped because they were entirely outside of the viewport
+    u64 Culled    = 0;
+};
+
+// Conservative visibility tests, primitives that might touch the bounds are always kept
+struct CullingBounds{
+    Vector2f Min = {0.f, 0.f};
+    Vector2f Max = {0.f, 0.f};
+    bool Enabled = false;
+
+    // bounds of a viewport centered around the origin, as renderers' projections are
+    static CullingBounds Centered(Vector2f size){
+        return {-size / 2.f, size / 2.f, true};
+    }
+
+    bool IsVisible(Vector2f min, Vector2f max)const{
+        return !Enabled || (max.x >= Min.x && min.x <= Max.x && max.y >= Min.y && min.y <= Max.y);
+    }
+
+    bool IsCircleVisible(Vector2f center, Vector2f extent)const{
+        return IsVisible(center - extent, center + extent);
+    }
+
+    bool IsRectVisible(Vector2f position, Vector2f size, Vector2f origin, float angle)const{
+        if(!Enabled)
+            return true;
+
+        Vector2f first = position - origin;
+        Vector2f last  = first + size;
+
+        if(angle == 0.f)
+            return IsVisible({Math::Min(first.x, last.x), Math::Min(first.y, last.y)}, {Math::Max(first.x, last.x), Math::Max(first.y, last.y)});
+
+        // any rotation around origin stays within the circle through the farthest corner,
+        // sqrt(2) * max(dx, dy) is a cheap upper bound of its radius
+        float dx = Math::Max(Math::Abs(origin.x), Math::Abs(size.x - origin.x));
+        float dy = Math::Max(Math::Abs(origin.y), Math::Abs(size.y - origin.y));
+        float radius = Math::Max(dx, dy) * 1.41422f;
+
+        return IsCircleVisible(position, {radius, radius});
+    }
+
+    // extent accounts for line width
+    bool IsSegmentVisible(Vector2f first, Vector2f last, float extent)const{
+        return IsVisible({Math::Min(first.x, last.x) - extent, Math::Min(first.y, last.y) - extent}, {Math::Max(first.x, last.x) + extent, Math::Max(first.y, last.y) + extent});
+    }
+};
+
+#endif//STRAITX_2D_COMMON_CULLING_HPP
@@ -0,0 +1,15 @@
+#ifndef STRAITX_2D_COMMON_FRAMES_IN_FLIGHT_HPP
+#define STRAITX_2D_COMMON_FRAMES_IN_FLIGHT_HPP
+
+#include "core/types.hpp"
+
+constexpr size_t DefaultFramesInFlight = 2;
+
+struct FramesInFlightStats{
+    // batches submitted to the GPU
+    u64 SubmittedFrames = 0;
+    // times CPU had to wait because every frame of the ring was still in use by the GPU
+    u64 RingExhausted   = 0;
+};
+
+#endif//STRAITX_2D_COMMON_FRAMES_IN_FLIGHT_HPP
@@ -0,0 +1,20 @@
+#ifndef STRAITX_2D_COMMON_QUAD_INDEX_BUFFER_HPP
+#define STRAITX_2D_COMMON_QUAD_INDEX_BUFFER_HPP
+
+#include "core/types.hpp"
+
+class Buffer;
+
+// Immutable VRAM buffer filled once with (0, 1, 2, 2, 3, 0) + 4 * n indices,
+// shared between all renderers that draw quads
+class QuadIndexBuffer{
+public:
+    static constexpr size_t MaxQuadsCount  = 1 << 18;
+    static constexpr size_t MaxIndicesCount = MaxQuadsCount * 6;
+public:
+    static const Buffer *Acquire();
+
+    static void Release();
+};
+
+#endif//STRAITX_2D_COMMON_QUAD_INDEX_BUFFER_HPP
@@ -0,0 +1,55 @@
+#ifndef STRAITX_2D_COMMON_RENDER_STATS_HPP
+#define STRAITX_2D_COMMON_RENDER_STATS_HPP
+
+#include <chrono>
+#include "core/types.hpp"
+
+// Stats are collected unless SX_2D_NO_RENDER_STATS is defined, then every counter stays zero
+#ifndef SX_2D_NO_RENDER_STATS
+    #define SX_2D_RENDER_STATS 1
+#else
+    #define SX_2D_RENDER_STATS 0
+#endif
+
+struct RenderStats{
+    // primitives that made it into a batch, culled ones are counted by ViewportCullingStats
+    u64 Primitives       = 0;
+    u64 Batches          = 0;
+    u64 DrawCalls        = 0;
+    u64 DescriptorWrites = 0;
+    // mapped writes and command buffer copies into GPU buffers
+    u64 BytesUploaded    = 0;
+    // CPU time of bulk paths writing instances and vertices, single primitive calls are not timed
+    u64 GenerationNanoseconds = 0;
+    // CPU time blocked on fences of frames still used by the GPU
+    u64 FenceWaitNanoseconds  = 0;
+};
+
+#if SX_2D_RENDER_STATS
+
+class ScopedStatsTimer{
+private:
+    u64 &m_Counter;
+    std::chrono::steady_clock::time_point m_Begin;
+public:
+    ScopedStatsTimer(u64 &counter):
+        m_Counter(counter),
+        m_Begin(std::chrono::steady_clock::now())
+    {}
+
+    ~ScopedStatsTimer(){
+        m_Counter += (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Begin).count();
+    }
+};
+
+#define SX_2D_STATS(statement) statement
+#define SX_2D_STATS_TIMER(counter) ScopedStatsTimer stats_timer(counter)
+
+#else
+
+#define SX_2D_STATS(statement)
+#define SX_2D_STATS_TIMER(counter)
+
+#endif
+
+#endif//STRAITX_2D_COMMON_RENDER_STATS_HPP
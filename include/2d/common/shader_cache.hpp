@@ -0,0 +1,42 @@
+#ifndef STRAITX_2D_COMMON_SHADER_CACHE_HPP
+#define STRAITX_2D_COMMON_SHADER_CACHE_HPP
+
+#include "core/types.hpp"
+#include "core/span.hpp"
+#include "core/list.hpp"
+#include "graphics/api/shader.hpp"
+
+// Backend entry points StraitXBase doesn't expose through its own API yet.
+// Every hook is optional, missing ones fall back to compiling embedded sources
+// and to pipelines created without a cache
+struct ShaderCacheHooks{
+    // creates a module from SPIR-V compiled at build time (STRAITX_2D_PRECOMPILE_SHADERS),
+    // may return nullptr to have the sources compiled instead
+    Shader *(*CreateFromBinary)(ShaderStageBits::Value stage, ConstSpan<u32> binary) = nullptr;
+    // seeds backend's pipeline cache with data saved by a previous run
+    void (*ImportPipelineCache)(ConstSpan<u8> data) = nullptr;
+    // current contents of backend's pipeline cache
+    List<u8> (*ExportPipelineCache)() = nullptr;
+};
+
+// Shaders created from embedded sources are shared between all renderers and queues,
+// so each source is compiled once per process while anything still references it.
+// Sources are matched by content and should outlive the cache entry, like static strings do.
+// Safe to use from several threads
+class ShaderCache{
+public:
+    // should be called before any renderer is created
+    static void SetHooks(const ShaderCacheHooks &hooks);
+
+    static const Shader *Acquire(ShaderStageBits::Value stage, const char *sources);
+
+    static void Release(const Shader *shader);
+
+    // Pipeline cache is kept on disk as an opaque blob of the backend. Load should go before
+    // the first renderer is created, Save at shutdown. Both return false without hooks or on IO failure
+    static bool LoadPipelineCache(const char *path);
+
+    static bool SavePipelineCache(const char *path);
+};
+
+#endif//STRAITX_2D_COMMON_SHADER_CACHE_HPP
@@ -0,0 +1,10 @@
+#ifndef STRAITX_2D_COMMON_STATIC_BUFFER_HPP
+#define STRAITX_2D_COMMON_STATIC_BUFFER_HPP
+
+#include "core/types.hpp"
+#include "graphics/api/buffer.hpp"
+
+// Creates immutable VRAM buffer filled with data through a staging copy, blocks until upload is done
+Buffer *CreateStaticBuffer(const void *data, size_t size, BufferUsage usage);
+
+#endif//STRAITX_2D_COMMON_STATIC_BUFFER_HPP
@@ -0,0 +1,26 @@
+#ifndef STRAITX_2D_COMMON_VIEW_UNIFORM_HPP
+#define STRAITX_2D_COMMON_VIEW_UNIFORM_HPP
+
+#include "core/math/vector2.hpp"
+#include "core/math/matrix4.hpp"
+#include "2d/common/viewport_parameters.hpp"
+
+// World to pixels transform of circle and line shaders, their MatricesUniform block.
+// Circles are moved by the offset after scaling and lines before it, as they always were,
+// so one uniform serves both and Renderer2D keeps a single one per frame
+struct ViewUniform{
+    Matrix4f u_Projection{1.0f};
+    Vector2f u_ViewScale {1.f, 1.f};
+    Vector2f u_ViewOffset{0.f, 0.f};
+
+    static ViewUniform Make(Vector2u framebuffer_size, const ViewportParameters &viewport){
+        ViewUniform uniform;
+        uniform.u_Projection[0][0] = 2.f/framebuffer_size.x;
+        uniform.u_Projection[1][1] = 2.f/framebuffer_size.y;
+        uniform.u_ViewScale  = viewport.Scale;
+        uniform.u_ViewOffset = Vector2f(framebuffer_size/2u) - viewport.Offset;
+        return uniform;
+    }
+};
+
+#endif//STRAITX_2D_COMMON_VIEW_UNIFORM_HPP
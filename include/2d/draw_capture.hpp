@@ -0,0 +1,133 @@
+#ifndef STRAITX_2D_DRAW_CAPTURE_HPP
+#define STRAITX_2D_DRAW_CAPTURE_HPP
+
+#include <cstdio>
+#include <unordered_map>
+#include "core/math/vector2.hpp"
+#include "core/span.hpp"
+#include "core/noncopyable.hpp"
+#include "graphics/color.hpp"
+#include "2d/common/viewport_parameters.hpp"
+
+class Texture2D;
+class Framebuffer;
+class Semaphore;
+class CommandBuffer;
+class RectRenderer;
+class CircleRenderer;
+class LineRenderer;
+
+// File is a header followed by commands, each one is a u32 type, u32 payload size and payload.
+// Every field is 4 bytes wide, so bulk arrays are read in place from a mapped file
+enum class DrawCommandType: u32{
+    // framebuffer size and viewport
+    RectRender   = 0,
+    CirclesBegin = 1,
+    LinesBegin   = 2,
+    // no payload
+    CirclesEnd   = 3,
+    LinesEnd     = 4,
+    // primitives
+    Rect         = 5,
+    Rects        = 6,
+    Circle       = 7,
+    Circles      = 8,
+    Lines        = 9
+};
+
+// Serializes renderer calls into a binary file, attach it with SetCapture of each renderer.
+// Draws are captured before culling. Recorders are merged as finished instances, so they are not captured.
+// Flushes are not, full batches are split again by the renderer a capture is replayed into.
+// Textures are stored as ids in order of their first use, 0 is Texture2D::White()
+class DrawCapture: public NonCopyable{
+public:
+    static constexpr u32 Magic   = 0x43325853; // "SX2C"
+    static constexpr u32 Version = 1;
+private:
+    // stdio buffers commands, the file is flushed at frame boundaries so a crash keeps whole frames
+    std::FILE *m_File = nullptr;
+    std::unordered_map<const Texture2D *, u32> m_TextureIds;
+public:
+    DrawCapture(const char *path);
+
+    ~DrawCapture();
+
+    bool IsOpen()const{
+        return m_File != nullptr;
+    }
+
+    void Boundary(DrawCommandType type, Vector2u framebuffer_size, const ViewportParameters &viewport);
+
+    void Boundary(DrawCommandType type);
+
+    void Rect(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, const Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max);
+
+    void Rects(ConstSpan<Vector2f> positions, ConstSpan<Vector2f> sizes, ConstSpan<float> angles, ConstSpan<Color> colors, const Texture2D *texture);
+
+    void Circle(Vector2s center, float radius, Color color);
+
+    void Circles(ConstSpan<Vector2f> centers, ConstSpan<float> radii, ConstSpan<Color> colors);
+
+    void Lines(ConstSpan<Vector2s> points, Color color, u32 width);
+
+    void Flush();
+private:
+    void BeginCommand(DrawCommandType type, size_t payload_size);
+
+    void Write(const void *data, size_t size);
+
+    template<typename Type>
+    void Write(const Type &value){
+        Write(&value, sizeof(value));
+    }
+
+    u32 TextureId(const Texture2D *texture);
+};
+
+struct DrawCaptureCommand{
+    DrawCommandType Type = DrawCommandType::RectRender;
+    const u8 *Payload = nullptr;
+    size_t PayloadSize = 0;
+    // only valid for RectRender, CirclesBegin and LinesBegin
+    Vector2u FramebufferSize = {0, 0};
+};
+
+// Renderers and resources a capture is replayed into. Commands of missing renderers are skipped
+struct DrawCaptureTargets{
+    RectRenderer   *Rects   = nullptr;
+    CircleRenderer *Circles = nullptr;
+    LineRenderer   *Lines   = nullptr;
+
+    // RectRender only records, submission is up to the caller
+    CommandBuffer *CmdBuffer = nullptr;
+    const Framebuffer *Target = nullptr;
+    const Semaphore *WaitSemaphore = nullptr;
+    const Semaphore *SignalSemaphore = nullptr;
+
+    // texture id N > 0 maps to Textures[(N - 1) % size], White() is used when it's empty
+    ConstSpan<Texture2D *> Textures;
+};
+
+// Walks a capture in memory without copying it, the memory should outlive the reader
+class DrawCaptureReader{
+private:
+    const u8 *m_Data = nullptr;
+    size_t m_Size   = 0;
+    size_t m_Offset = 0;
+    bool m_IsValid  = false;
+public:
+    DrawCaptureReader(const void *data, size_t size);
+
+    bool IsValid()const{
+        return m_IsValid;
+    }
+
+    // false at the end of data or on a truncated command
+    bool Next(DrawCaptureCommand &command);
+
+    void Rewind();
+
+    static void Replay(const DrawCaptureCommand &command, const DrawCaptureTargets &targets);
+};
+
+#endif//STRAITX_2D_DRAW_CAPTURE_HPP
@@ -0,0 +1,187 @@
+#ifndef STRAITX_2D_DRAW_QUEUE_HPP
+#define STRAITX_2D_DRAW_QUEUE_HPP
+
+#include "core/math/vector2.hpp"
+#include "core/math/matrix4.hpp"
+#include "core/unique_ptr.hpp"
+#include "core/span.hpp"
+#include "core/list.hpp"
+#include "core/array.hpp"
+#include "core/fixed_list.hpp"
+#include "core/noncopyable.hpp"
+#include "graphics/color.hpp"
+#include "graphics/api/descriptor_set.hpp"
+#include "graphics/api/framebuffer.hpp"
+#include "graphics/api/graphics_pipeline.hpp"
+#include "2d/common/viewport_parameters.hpp"
+#include "2d/common/frames_in_flight.hpp"
+#include "2d/common/view_uniform.hpp"
+#include "2d/rect_renderer.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "2d/texture_atlas.hpp"
+
+class RenderPass;
+class Shader;
+class CommandBuffer;
+class Buffer;
+class Texture2D;
+
+// Takes rects, circles and lines with a layer, sorts them and records everything
+// into a single render pass of caller's command buffer, like RectRenderer does.
+// Lower layers are drawn first. Inside of a layer primitives are grouped by type and lines
+// by width, rects and circles keep their submission order within the type
+class DrawQueue: public NonCopyable{
+public:
+    using Layer = u16;
+
+    static constexpr size_t MaxTexturesInBatch = 15;
+private:
+    enum class PrimitiveType: u32{
+        Rect   = 0,
+        Circle = 1,
+        Line   = 2
+    };
+
+    using RectInstance   = RectRenderer::RectInstance;
+    using CircleInstance = CircleRenderer::CircleInstance;
+    using LineVertex     = LineRenderer::LineVertex;
+
+    struct RectUniform{
+        Matrix4f u_Projection{1.0f};
+    };
+
+    struct Polyline{
+        size_t FirstPoint = 0;
+        size_t PointsCount = 0;
+        u32 Width = 1;
+    };
+
+    // consecutive primitives of the same type drawn with a single call
+    struct Run{
+        PrimitiveType Type = PrimitiveType::Rect;
+        // rect runs are relative to their upload chunk
+        size_t Chunk = 0;
+        size_t First = 0;
+        size_t Count = 0;
+        u32 LineWidth = 1;
+        FixedList<const Texture2D*, MaxTexturesInBatch> Textures;
+    };
+
+    // staging memory is written at CmdRender and copied into Device buffer of the same size
+    struct UploadBuffer{
+        Buffer *Staging = nullptr;
+        Buffer *Device  = nullptr;
+        u8     *Data    = nullptr;
+
+        ~UploadBuffer();
+
+        void *Reserve(size_t size, BufferUsage usage);
+    };
+
+    struct Frame{
+        // quad indices can't address past MaxQuadsCount rects, so each chunk holds at most that many
+        List<UploadBuffer *> RectChunks;
+        UploadBuffer Circles;
+        UploadBuffer LineVertices;
+        UploadBuffer LineIndices;
+
+        // sets are referenced by the frame's command buffer until it retires
+        UniquePtr<SingleFrameDescriptorSetPool> RectSetPool;
+        UniquePtr<SingleFrameDescriptorSetPool> CircleSetPool;
+        UniquePtr<SingleFrameDescriptorSetPool> LineSetPool;
+
+        ~Frame();
+    };
+
+    static constexpr size_t MaxSets = 16;
+    static constexpr size_t PreallocatedSets = 1;
+    // key is layer, type and then line width, rects are batched by textures in BuildRuns
+    static constexpr u32 SubkeyBits = 14;
+    static constexpr u32 MaxSubkey  = (1 << SubkeyBits) - 1;
+private:
+    const RenderPass *m_FramebufferPass = nullptr;
+
+    Array<const Shader *, 6> m_Shaders = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+
+    UniquePtr<DescriptorSetLayout> m_RectSetLayout;
+    UniquePtr<DescriptorSetLayout> m_CircleSetLayout;
+    UniquePtr<DescriptorSetLayout> m_LineSetLayout;
+
+    UniquePtr<GraphicsPipeline> m_RectPipeline;
+    UniquePtr<GraphicsPipeline> m_CirclePipeline;
+    UniquePtr<GraphicsPipeline> m_LinePipeline;
+
+    StructBuffer<RectUniform> m_RectUniformBuffer;
+    // shared by circle and line sets
+    StructBuffer<ViewUniform> m_ViewUniformBuffer;
+
+    UniquePtr<Sampler> m_DefaultSampler{
+        Sampler::Create({})
+    };
+
+    const Buffer *m_IndexBuffer = nullptr;
+
+    UniquePtr<Frame[]> m_Frames;
+    size_t m_FramesCount  = 0;
+    size_t m_CurrentFrame = 0;
+
+    // primitives in submission order, their texture index is resolved at CmdRender
+    List<RectInstance> m_Rects;
+    List<const Texture2D *> m_RectTextures;
+    List<CircleInstance> m_Circles;
+    List<LineVertex> m_LinePoints;
+    List<Polyline> m_Polylines;
+
+    // sort key in upper half, index into type's list in lower one
+    List<u64> m_Commands;
+    UniquePtr<u64[]> m_SortScratch;
+    size_t m_SortScratchCapacity = 0;
+    List<Run> m_Runs;
+    // staging of every rect chunk of the frame being built
+    List<RectInstance *> m_RectChunksData;
+public:
+    DrawQueue(const RenderPass *rp, size_t frames_in_flight = DefaultFramesInFlight);
+
+    ~DrawQueue();
+
+    void DrawRect(Layer layer, Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture = Texture2D::White(), Vector2f tex_coords_min = {0.f, 0.f}, Vector2f tex_coords_max = {1.f, 1.f});
+
+    void DrawRect(Layer layer, Vector2f position, Vector2f size, Color color, const AtlasRegion &region){
+        DrawRect(layer, position, size, {0.f, 0.f}, 0, color, region.Page, region.TexCoordsMin, region.TexCoordsMax);
+    }
+
+    // Center and radius are in world space, like CircleRenderer's ones
+    void DrawCircle(Layer layer, Vector2f center, float radius, Color color);
+
+    // Points are in world space, like LineRenderer's ones
+    void DrawLines(Layer layer, ConstSpan<Vector2s> points, Color color, u32 width = 1);
+
+    void DrawLine(Layer layer, Vector2s first, Vector2s last, Color color, u32 width = 1){
+        Vector2s points[2] = {first, last};
+        DrawLines(layer, {points, lengthof(points)}, color, width);
+    }
+
+    // Records uploads, then a single render pass with every queued primitive, and clears the queue
+    void CmdRender(CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport);
+
+    void CmdRender(CommandBuffer* cmd_buffer, const Framebuffer* fb) {
+        ViewportParameters default_parameters;
+        default_parameters.ViewportOffset = {0.f, 0.f};
+        default_parameters.ViewportSize = Vector2f(fb->Size());
+        CmdRender(cmd_buffer, fb, default_parameters);
+    }
+
+    // Renderer2D this is attached to should have the same number
+    size_t FramesInFlight()const{
+        return m_FramesCount;
+    }
+private:
+    void PushCommand(Layer layer, PrimitiveType type, u32 subkey, size_t index);
+
+    void BuildRuns(RectInstance *const *rect_chunks, CircleInstance *circles, LineVertex *line_vertices, u32 *line_indices);
+
+    void Clear();
+};
+
+#endif//STRAITX_2D_DRAW_QUEUE_HPP
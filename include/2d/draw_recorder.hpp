@@ -0,0 +1,113 @@
+#ifndef STRAITX_2D_DRAW_RECORDER_HPP
+#define STRAITX_2D_DRAW_RECORDER_HPP
+
+#include "core/math/vector2.hpp"
+#include "core/list.hpp"
+#include "core/span.hpp"
+#include "core/fixed_list.hpp"
+#include "core/noncopyable.hpp"
+#include "graphics/color.hpp"
+#include "graphics/api/texture.hpp"
+#include "2d/rect_renderer.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "2d/texture_atlas.hpp"
+
+// Records draw calls on any thread, to be merged into renderers later.
+// Recorder is not synchronized, so each producer thread should own its own recorder
+// and finish recording before the renderer it was submitted to reaches CmdRender/EndDrawing.
+// Primitives are built in their GPU layout right away, so merging them is a copy into upload memory.
+// Merged primitives skip renderer's culling, decimation and capture
+class DrawRecorder: public NonCopyable{
+public:
+    using RectInstance   = RectRenderer::RectInstance;
+    using CircleInstance = CircleRenderer::CircleInstance;
+    using LineVertex     = LineRenderer::LineVertex;
+
+    static constexpr size_t MaxTexturesInRange = 15;
+
+    // consecutive rects using up to MaxTexturesInRange textures,
+    // texture indices of their instances point into the range's list
+    struct RectRange{
+        FixedList<const Texture2D *, MaxTexturesInRange> Textures;
+        size_t FirstInstance = 0;
+        size_t InstancesCount = 0;
+    };
+
+    struct PolylineRecord{
+        size_t FirstVertex;
+        size_t VerticesCount;
+        u32    Width;
+    };
+private:
+    List<RectInstance> m_Rects;
+    List<RectRange>    m_RectRanges;
+
+    List<CircleInstance> m_Circles;
+
+    List<LineVertex>     m_LineVertices;
+    List<PolylineRecord> m_Polylines;
+public:
+    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, const Texture2D *texture, Vector2f tex_coords_min = {0.f, 0.f}, Vector2f tex_coords_max = {1.f, 1.f});
+
+    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color){
+        DrawRect(position, size, origin, angle, color, Texture2D::White());
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, float angle, Color color){
+        DrawRect(position, size, size/2.f, angle, color, Texture2D::White());
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, Color color, const Texture2D *texture){
+        DrawRect(position, size, {0.f, 0.f}, 0, color, texture);
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, Color color){
+        DrawRect(position, size, {0.f, 0.f}, 0, color, Texture2D::White());
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, const AtlasRegion &region){
+        DrawRect(position, size, origin, angle, color, region.Page, region.TexCoordsMin, region.TexCoordsMax);
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, Color color, const AtlasRegion &region){
+        DrawRect(position, size, {0.f, 0.f}, 0, color, region.Page, region.TexCoordsMin, region.TexCoordsMax);
+    }
+
+    void DrawCircle(Vector2s center, float radius, Color color);
+
+    void DrawLines(ConstSpan<Vector2s> points, Color color, u32 width = 1);
+
+    void DrawLine(Vector2s first, Vector2s last, Color color, u32 width = 1){
+        Vector2s points[2] = {first, last};
+        DrawLines({points, lengthof(points)}, color, width);
+    }
+
+    void Clear();
+
+    ConstSpan<RectInstance> Rects()const{
+        return {m_Rects.Data(), m_Rects.Size()};
+    }
+
+    const List<RectRange> &RectRanges()const{
+        return m_RectRanges;
+    }
+
+    ConstSpan<CircleInstance> Circles()const{
+        return {m_Circles.Data(), m_Circles.Size()};
+    }
+
+    ConstSpan<LineVertex> LineVertices()const{
+        return {m_LineVertices.Data(), m_LineVertices.Size()};
+    }
+
+    const List<PolylineRecord> &Polylines()const{
+        return m_Polylines;
+    }
+
+    ConstSpan<LineVertex> PolylineVertices(const PolylineRecord &polyline)const{
+        return {m_LineVertices.Data() + polyline.FirstVertex, polyline.VerticesCount};
+    }
+};
+
+#endif//STRAITX_2D_DRAW_RECORDER_HPP
@@ -9,7 +9,10 @@
 #include "core/fixed_list.hpp"
 #include "core/noncopyable.hpp"
 #include "core/raw_var.hpp"
-#include "core/ring.hpp"
+#include "core/unique_ptr.hpp"
+#include "core/span.hpp"
+#include "core/math/functions.hpp"
+#include "core/list.hpp"
 #include "graphics/color.hpp"
 #include "graphics/api/semaphore.hpp"
 #include "graphics/api/fence.hpp"
@@ -17,6 +20,10 @@
 
 #include "2d/common/semaphore_ring.hpp"
 #include "2d/common/viewport_parameters.hpp"
+#include "2d/common/frames_in_flight.hpp"
+#include "2d/common/culling.hpp"
+#include "2d/common/render_stats.hpp"
+#include "2d/common/view_uniform.hpp"
 
 class RenderPass;
 class Framebuffer;
@@ -24,26 +31,120 @@ class Shader;
 class GraphicsPipeline;
 class CommandPool;
 class CommandBuffer;
+class DrawCapture;
+class DrawRecorder;
 class Fence;
 class Buffer;
 class Texture2D;
+class Renderer2D;
 
 class LineRenderer: public NonCopyable{
 public:
+    enum class LineMode{
+        // LinesStrip pipeline, batch is flushed whenever line width changes. Wide lines require device support
+        Native,
+        // every segment is expanded into a quad in the vertex shader, lines of any width share a batch
+        Expanded
+    };
+
+    enum class LineJoin: u32{
+        Miter = 0,
+        Round = 1
+    };
+
     struct LineVertex{
         Vector2f a_Position;
         u32      a_Color;
     };
+
+    // one instance per segment in Expanded mode, directions to neighbours are snorm16 and zero when there is none.
+    // Width is in the low 16 bits, LineJoin the segment was drawn with is in the high ones
+    struct LineSegment{
+        Vector2f a_First;
+        Vector2f a_Last;
+        u32      a_PrevDirection;
+        u32      a_NextDirection;
+        u32      a_WidthAndJoin;
+        u32      a_Color;
+    };
     static constexpr size_t MaxVerticesInBatch = 20000 * 4;
     static constexpr size_t MaxIndicesInBatch  = 20000 * 6;
-private:
-    static constexpr  u32 InvalidLineWidth = -1;
+    static constexpr size_t MaxSegmentsInBatch = 20000 * 4;
+
+    // Lines of a recorder uploaded once into VRAM in world space,
+    // current viewport is applied on the GPU every time geometry is drawn
+    class StaticGeometry: public NonCopyable{
+    private:
+        // consecutive polylines of the same width are drawn with one call
+        struct Range{
+            u32 FirstIndex = 0;
+            u32 IndicesCount = 0;
+            u32 LineWidth = 1;
+        };
+
+        Buffer *m_Vertices = nullptr;
+        Buffer *m_Indices  = nullptr;
+        List<Range> m_Ranges;
+    public:
+        StaticGeometry(const DrawRecorder &recorder);
+
+        ~StaticGeometry();
+
+        friend class LineRenderer;
+    };
+
+    // Polyline in a VRAM ring, points are uploaded once and retired from the front, so drawing it
+    // costs the same regardless of its length. Appended points are kept on the CPU until the polyline
+    // is drawn, then they are copied into the ring by the command buffer of that frame, ordered after
+    // draws of earlier frames still reading slots of retired points
+    class StreamingPolyline: public NonCopyable{
+    private:
+        Buffer *m_Vertices = nullptr;
+        // 0..capacity-1 twice, so points wrapping around the end of the ring are still one strip
+        Buffer *m_Indices  = nullptr;
+        // CPU copy of the ring, points appended since the last draw are uploaded from it
+        UniquePtr<LineVertex[]> m_Points;
+        size_t m_Capacity = 0;
+        size_t m_First = 0;
+        size_t m_Size  = 0;
+        // run of slots ending at the last point, which is not uploaded yet
+        size_t m_PendingCount = 0;
+        u32 m_LineWidth = 1;
+    public:
+        StreamingPolyline(size_t capacity, u32 width = 1);
+
+        ~StreamingPolyline();
+
+        // Oldest points are retired when there is no room for new ones. Nothing reaches GPU until DrawStreaming
+        void Append(ConstSpan<Vector2s> points, Color color);
+
+        void Retire(size_t count);
+
+        void Clear(){
+            Retire(m_Size);
+        }
+
+        void SetWidth(u32 width){
+            m_LineWidth = width;
+        }
+
+        size_t Size()const{
+            return m_Size;
+        }
+
+        size_t Capacity()const{
+            return m_Capacity;
+        }
 
-    struct MatricesUniform{
-        Matrix4f u_Projection{1.0f};
+        friend class LineRenderer;
     };
+private:
+    static constexpr  u32 InvalidLineWidth = -1;
+    static constexpr size_t MaxViewports   = 4;
+    static constexpr size_t StreamingChunkSize = 64 * 1024 * sizeof(LineVertex);
 
     struct Batch{
+        // allocated only in Native mode
         Buffer *VerticesBuffer = nullptr;
         Buffer *IndicesBuffer  = nullptr;
         LineVertex *Vertices = nullptr;
@@ -51,50 +152,146 @@ private:
         size_t      SubmitedIndicesCount = 0;
         size_t      SubmitedVerticesCount = 0;
         u32         LineWidth = InvalidLineWidth;
+        // staging is copied here before drawing
+        Buffer *VertexBuffer = nullptr;
+        Buffer *IndexBuffer  = nullptr;
+
+        // allocated only in Expanded mode
+        Buffer      *SegmentsBuffer = nullptr;
+        LineSegment *Segments = nullptr;
+        size_t       SubmitedSegmentsCount = 0;
+        Buffer      *SegmentBuffer = nullptr;
 
-        Batch();
+        Batch(LineMode mode);
 
         ~Batch();
 
         void Reset();
 
-        bool IsGeometryFull()const{
-            return SubmitedVerticesCount == MaxVerticesInBatch || SubmitedIndicesCount == MaxIndicesInBatch;
+        // vertices a strip can still get, one index is kept for its restart
+        size_t StripRoom()const{
+            if(SubmitedIndicesCount >= MaxIndicesInBatch)
+                return 0;
+            return Math::Min(MaxVerticesInBatch - SubmitedVerticesCount, MaxIndicesInBatch - SubmitedIndicesCount - 1);
+        }
+
+        bool IsSegmentsFull()const{
+            return SubmitedSegmentsCount >= MaxSegmentsInBatch;
         }
     };
+
+    struct ViewportSlot{
+        DescriptorSet *Set = nullptr;
+        Buffer *MatricesUniformBuffer = nullptr;
+    };
+
+    // BeginDrawing/EndDrawing submissions, created on the first BeginDrawing,
+    // so a renderer attached to Renderer2D never has them
+    struct Submission{
+        CommandBuffer *CmdBuffer = nullptr;
+        Fence DrawingFence;
+
+        Array<ViewportSlot, MaxViewports> Viewports;
+    };
+
+    struct Frame{
+        // BeginDrawing/EndDrawing flush the first batch whenever it's full,
+        // Renderer2D frames go on in the next one and draw them all at once
+        List<Batch *> Batches;
+        size_t CurrentBatch = 0;
+
+        // staging of streaming polylines, chunks are kept for following frames
+        List<Buffer *> StreamingChunks;
+        size_t StreamingChunk  = 0;
+        size_t StreamingOffset = 0;
+
+        ~Frame();
+
+        Batch &Staging(){
+            return *Batches[CurrentBatch];
+        }
+    };
+
+    // appended points of a streaming polyline, copied from frame's staging before its draw
+    struct StreamingUpload{
+        const Buffer *Staging = nullptr;
+        Buffer *Vertices = nullptr;
+        size_t StagingOffset  = 0;
+        size_t VerticesOffset = 0;
+        size_t Size = 0;
+    };
+
+    // one draw call of the frame recorded into Renderer2D's command buffer,
+    // Expanded mode draws segments with the quad index buffer
+    struct RecordedDraw{
+        const Buffer *Vertices = nullptr;
+        const Buffer *Indices  = nullptr;
+        u32 FirstIndex   = 0;
+        u32 IndicesCount = 0;
+        u32 LineWidth    = 1;
+    };
 private:
 
     //XXX: do something about allocation
     const RenderPass *m_FramebufferPass = nullptr;
     const Framebuffer *m_Framebuffer = nullptr;
+    LineMode m_Mode = LineMode::Native;
     const DescriptorSetLayout *m_SetLayout = nullptr;
-    DescriptorSetPool         *m_SetPool   = nullptr;
-    DescriptorSet             *m_Set       = nullptr;
 
     Array<const Shader *, 2> m_Shaders = {nullptr, nullptr};
     GraphicsPipeline *m_Pipeline       = nullptr;
 
-    CommandPool   *m_CmdPool   = nullptr;
-    CommandBuffer *m_CmdBuffer = nullptr;
+    const Buffer *m_QuadIndexBuffer = nullptr;
+
+    UniquePtr<Frame[]> m_Frames;
+    size_t m_FramesCount  = 0;
+    size_t m_CurrentFrame = 0;
 
-    Ring<Batch, 2> m_BatchRing;
+    UniquePtr<CommandPool>       m_CmdPool;
+    UniquePtr<DescriptorSetPool> m_SetPool;
+    UniquePtr<Submission[]>      m_Submissions;
 
     SemaphoreRing m_SemaphoreRing;
 
-    MatricesUniform    m_MatricesUniform;
-    ViewportParameters m_CurrentViewport;
+    FixedList<ViewportParameters, MaxViewports> m_Viewports;
+    Array<ViewUniform, MaxViewports> m_ViewportUniforms;
+    Vector2f m_FramebufferSize = {0.f, 0.f};
+    LineJoin m_LineJoin = LineJoin::Miter;
+
+    // set while attached, drawing is recorded into the context's frame then
+    Renderer2D *m_Context = nullptr;
+    List<RecordedDraw> m_RecordedDraws;
+    // recorded before the render pass, of the next submit or of the context's frame
+    List<StreamingUpload> m_StreamingUploads;
+    // indices, or segments in Expanded mode, of the current batch already covered by recorded draws
+    size_t m_RecordedCount = 0;
+
+    FramesInFlightStats m_FramesStats;
+
+    CullingBounds        m_CullingBounds;
+    ViewportCullingStats m_CullingStats;
 
-    Fence m_DrawingFence;
+    RenderStats m_Stats;
+    RenderStats m_LastFrameStats;
 
-    Buffer *m_VertexBuffer = nullptr;
-    Buffer *m_IndexBuffer  = nullptr;
-    Buffer *m_MatricesUniformBuffer = nullptr;
+    DrawCapture *m_Capture = nullptr;
+
+    bool m_IsDecimationEnabled = false;
+    List<Vector2s> m_DecimatedPoints;
+
+    List<const DrawRecorder *> m_Recorders;
 public:
-    LineRenderer(const RenderPass *rp);
+    LineRenderer(const RenderPass *rp, size_t frames_in_flight = DefaultFramesInFlight, LineMode mode = LineMode::Native);
 
     ~LineRenderer();
 
-    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport);
+    // Lines are uploaded once and drawn into every viewport with its own transform and scissor,
+    // a segment is culled only when it's outside of all of them
+    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, ConstSpan<ViewportParameters> viewports);
+
+    Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport){
+        return BeginDrawing(wait_semaphore, framebuffer, ConstSpan<ViewportParameters>(&viewport, 1));
+    }
 
     Result BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer);
 
@@ -107,8 +304,124 @@ public:
         DrawLines({points, lengthof(points)}, color, width);
     }
     void Flush();
+
+    // Applies to segments drawn after it, Expanded mode only
+    void SetLineJoin(LineJoin join){
+        m_LineJoin = join;
+    }
+
+    // Consecutive points of a polyline falling into the same pixel column of the current viewport
+    // are reduced to the first, lowest, highest and last of them. Output looks the same, but dense
+    // series emit a few vertices per column instead of one per point.
+    // Columns differ between viewports, so it's skipped when drawing into several of them
+    void SetDecimation(bool enabled){
+        m_IsDecimationEnabled = enabled;
+    }
+
+    // Flushes pending lines to keep drawing order and replays geometry in a separate submit,
+    // or in the same pass when attached to Renderer2D. Native mode only
+    void DrawStatic(const StaticGeometry &geometry);
+
+    // Flushes pending lines to keep drawing order, uploads points appended since the last draw and draws
+    // the polyline with a single call. In Renderer2D frames uploads land before every draw of the frame,
+    // so a polyline appended to between its draws should be drawn once per frame. Native mode only
+    void DrawStreaming(StreamingPolyline &polyline);
+
+    // Lines of submitted recorders are copied at EndDrawing, after directly drawn ones, in submission order
+    void Submit(const DrawRecorder *recorder);
+
+    // Renderer2D this is attached to should have the same number
+    size_t FramesInFlight()const{
+        return m_FramesCount;
+    }
+
+    const FramesInFlightStats &FramesStats()const{
+        return m_FramesStats;
+    }
+
+    void ResetFramesStats(){
+        m_FramesStats = {};
+    }
+
+    // Culling and decimation of frames recorded into Renderer2D, which are not culled until it's set.
+    // BeginDrawing sets it from its own viewports
+    void SetCullingViewport(Vector2u framebuffer_size, const ViewportParameters &viewport);
+
+    void DisableCulling(){
+        m_CullingBounds = {};
+    }
+
+    // segments entirely outside of the framebuffer are dropped, breaking the strip
+    const ViewportCullingStats &CullingStats()const{
+        return m_CullingStats;
+    }
+
+    void ResetCullingStats(){
+        m_CullingStats = {};
+    }
+
+    // stats of the last frame finished by EndDrawing
+    const RenderStats &LastFrameStats()const{
+        return m_LastFrameStats;
+    }
+
+    // Every following call is serialized into capture until it's reset with nullptr.
+    // Only BeginDrawing/EndDrawing frames are captured
+    void SetCapture(DrawCapture *capture){
+        m_Capture = capture;
+    }
 private:
+    // Renderer2D's path, draws everything recorded since the last one into its command buffer
+    void CmdRender(Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport);
+
+    void CreateSubmissions();
+
     void Flush(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore);
+
+    // flushes the current batch or, when recording into Renderer2D, goes on in the next one
+    void NextBatch();
+
+    // covers lines written into the current batch since the last call with a recorded draw
+    void RecordPendingLines();
+
+    void SubmitRanges(const Buffer *vertices, const Buffer *indices, ConstSpan<StaticGeometry::Range> ranges);
+
+    // copies not yet uploaded points of the polyline into frame's staging and queues their upload
+    void StagePolyline(StreamingPolyline &polyline);
+
+    void RecordStreamingUploads(CommandBuffer *cmd_buffer);
+
+    // staging memory of the current frame, offset of the reserved range is returned through the parameter
+    Buffer *ReserveStreamingStaging(size_t size, size_t &offset);
+
+    void ResetStreamingStaging();
+
+    void UploadViewports(Submission &submission);
+
+    void SetViewport(CommandBuffer *cmd_buffer, const ViewportParameters &viewport);
+
+    bool IsSegmentVisible(Vector2f first, Vector2f last, float extent)const;
+
+    Frame &CurrentFrame(){
+        return m_Frames[m_CurrentFrame];
+    }
+
+    Submission &CurrentSubmission(){
+        return m_Submissions[m_CurrentFrame];
+    }
+
+    void AdvanceFrame();
+
+    void DrawSegments(ConstSpan<Vector2s> points, Color color, u32 width);
+
+    void MergeRecorders();
+
+    void CopyPolyline(ConstSpan<LineVertex> vertices, u32 width);
+
+    // current batch once it has the given width and room for a strip segment, flushes otherwise
+    Batch &StripBatch(u32 width);
+
+    friend class Renderer2D;
 };
 
 #endif//STRAITX_2D_LINE_RENDERER_HPP
\ No newline at end of file
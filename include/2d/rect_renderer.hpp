@@ -5,6 +5,9 @@
 #include "core/math/vector3.hpp"
 #include "core/math/matrix4.hpp"
 #include "core/unique_ptr.hpp"
+#include "core/list.hpp"
+#include "core/span.hpp"
+#include <unordered_map>
 #include "core/array.hpp"
 #include "core/fixed_list.hpp"
 #include "core/noncopyable.hpp"
@@ -15,78 +18,258 @@
 #include "graphics/api/framebuffer.hpp"
 #include "graphics/api/graphics_pipeline.hpp"
 #include "2d/common/viewport_parameters.hpp"
+#include "2d/common/frames_in_flight.hpp"
+#include "2d/common/culling.hpp"
+#include "2d/common/render_stats.hpp"
+#include "2d/texture_atlas.hpp"
 
 class RenderPass;
 class Shader;
 class GraphicsPipeline;
 class CommandPool;
 class CommandBuffer;
+class DrawCapture;
+class DrawRecorder;
 class Fence;
 class Buffer;
 class Texture2D;
 
 class RectRenderer: public NonCopyable{
-    static const Array<Vector2f, 4> s_DefaultTextureCoordinates;
+public:
+    enum class TexturingMode{
+        // up to Batch::MaxTexturesInBatch textures per batch, works everywhere
+        PerBatch,
+        // one persistent table of textures indexed per rect, batches never split on textures.
+        // Table is kept within device's per stage texture limit, once it's full drawing falls back
+        // to PerBatch batches until the table is reset. Requires descriptor indexing support
+        Bindless
+    };
+
+    // upper bound of the table, devices may allow less
+    static constexpr size_t MaxTexturesInTable = 4096;
+    static constexpr size_t DefaultPrimitivesInBatch = 6000;
+    static constexpr size_t DefaultTrimFrames = 300;
+    static constexpr size_t DefaultMaxCachedSets = 4096;
 
-    struct RectVertex{
+    // vertex shader pulls one record per rect, computes corners and applies rotation
+#if SX_2D_COMPACT_INSTANCES
+    // size and origin are halfs, angle is a unorm16 fraction of a turn sharing u32 with texture index,
+    // texture coordinates are unorm16, so they are limited to [0, 1] and can't repeat or mirror
+    struct RectInstance{
         Vector2f a_Position;
-        Vector2f a_TexCoords;
+        u32      a_Size;
+        u32      a_Origin;
+        u32      a_AngleAndTexIndex;
         u32      a_Color;
-        float    a_TexIndex;
+        u32      a_TexCoordsMin;
+        u32      a_TexCoordsMax;
+
+        static RectInstance Make(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, Vector2f tex_coords_min, Vector2f tex_coords_max, u32 tex_index);
+
+        u32 TexIndex()const{
+            return a_AngleAndTexIndex >> 16;
+        }
+
+        void SetTexIndex(u32 tex_index){
+            a_AngleAndTexIndex = (a_AngleAndTexIndex & 0xFFFF) | (tex_index << 16);
+        }
     };
+    static_assert(sizeof(RectInstance) == 32, "RectRenderer: RectInstance should match std430 layout of the compact vertex shader");
+#else
+    struct RectInstance{
+        Vector2f a_Position;
+        Vector2f a_Size;
+        Vector2f a_Origin;
+        float    a_Angle;
+        u32      a_Color;
+        Vector2f a_TexCoordsMin;
+        Vector2f a_TexCoordsMax;
+        u32      a_TexIndex;
+        u32      a_Padding;
+
+        static RectInstance Make(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, Vector2f tex_coords_min, Vector2f tex_coords_max, u32 tex_index){
+            return {position, size, origin, angle, color, tex_coords_min, tex_coords_max, tex_index, 0};
+        }
 
+        u32 TexIndex()const{
+            return a_TexIndex;
+        }
+
+        void SetTexIndex(u32 tex_index){
+            a_TexIndex = tex_index;
+        }
+    };
+    static_assert(sizeof(RectInstance) == 56, "RectRenderer: RectInstance should match std430 layout of the vertex shader");
+#endif
+private:
     struct MatricesUniform{
         Matrix4f u_Projection{1.0f};
     };
 
 
+    // persistently mapped staging memory rects are written to directly,
+    // only the used part of it gets copied into Device buffer at CmdRender.
+    // Capacity never exceeds QuadIndexBuffer::MaxQuadsCount
+    struct UploadArena {
+        Buffer *Staging = nullptr;
+        Buffer *Device  = nullptr;
+        RectInstance *Instances = nullptr;
+        size_t Capacity = 0;
+        size_t Size = 0;
+        // largest Size since the last trim check
+        size_t PeakSize = 0;
+        size_t FramesSinceTrim = 0;
+
+        ~UploadArena();
+
+        void Reserve(size_t capacity);
+
+        void Release();
+
+        RectInstance &Push();
+
+        RectInstance *Push(size_t count);
+
+        void Reset() {
+            Size = 0;
+        }
+    };
+
     struct Batch {
         static constexpr size_t MaxTexturesInBatch = 15;
 
         FixedList<const Texture2D*, MaxTexturesInBatch> Textures;
-        UniquePtr<RectVertex[]> Vertices;
-        UniquePtr<u16[]> Indices;
-        UniquePtr<Buffer> VertexBuffer;
-        UniquePtr<Buffer> IndexBuffer;
-        size_t SubmitedPrimitives = 0;
+        size_t Chunk = 0;
+        size_t FirstInstance = 0;
+        size_t InstancesCount = 0;
+        // indexes the texture table instead of Textures
+        bool IsBindless = false;
 
-        Batch(u16 max_primitives_count);
-
-        Batch(Batch&&)noexcept = default;
+        Batch(size_t chunk, size_t first_instance, bool is_bindless):
+            Chunk(chunk),
+            FirstInstance(first_instance),
+            IsBindless(is_bindless)
+        {}
         
-        bool IsFull()const;
+        bool IsFull(size_t max_primitives, size_t new_textures)const;
+
+        u32 TextureIndex(const Texture2D *texture);
+    };
 
-        void PushRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D* texture, const Array<Vector2f, 4>& texture_coords = s_DefaultTextureCoordinates);
+    struct BindlessFrame {
+        DescriptorSet *Set = nullptr;
+        size_t WrittenTextures = 0;
+        size_t TableGeneration = 0;
+        const Buffer *BoundInstances = nullptr;
+    };
 
-        u16 MaxPrimitivesCount()const;
+    // everything GPU may still use while the frame is in flight
+    struct Frame {
+        // once a chunk reaches QuadIndexBuffer::MaxQuadsCount rects spill into the next one,
+        // the first chunk is never released
+        List<UploadArena *> Chunks;
+        size_t CurrentChunk = 0;
+        UniquePtr<SingleFrameDescriptorSetPool> SetPool;
+        // only in Bindless mode, for spill chunks
+        UniquePtr<SingleFrameDescriptorSetPool> BindlessSetPool;
+        BindlessFrame Bindless;
 
-        void Reset() {
-            SubmitedPrimitives = 0;
-            Textures.Clear();
+        ~Frame();
+
+        UploadArena &Arena(){
+            return *Chunks[CurrentChunk];
         }
     };
 
+    // PerBatch mode texture combination that outlives a frame. Instances differ between frames,
+    // so it has a set per frame in flight in m_CachedSlots, only instances of a reused one are rewritten
+    struct CachedSet {
+        u64 Hash = 0;
+        FixedList<const Texture2D*, Batch::MaxTexturesInBatch> Textures;
+        const Sampler *TextureSampler = nullptr;
+        u64 LastUsedFrame = 0;
+        // changes with the key, slots written for another one are outdated
+        u64 Generation = 0;
+
+        bool Matches(u64 hash, const Batch &batch, const Sampler *sampler)const;
+    };
+
+    struct CachedSlot {
+        DescriptorSet *Set = nullptr;
+        u64 Generation = 0;
+        size_t WrittenTextures = 0;
+        const Buffer *Instances = nullptr;
+        u64 LastUsedFrame = -1;
+    };
+
+    static constexpr size_t CachedSetsInPool = 64;
+
 private:
 
     const RenderPass *m_FramebufferPass = nullptr;
+    TexturingMode m_TexturingMode = TexturingMode::PerBatch;
+    // PerBatch layout, Bindless mode keeps it for the fallback
     UniquePtr<DescriptorSetLayout> m_SetLayout;
+    UniquePtr<DescriptorSetLayout> m_BindlessSetLayout;
 
     static constexpr size_t MaxSets = 16;
     static constexpr size_t PreallocatedSets = 1;
-    SingleFrameDescriptorSetPool m_SetPool{ {MaxSets, m_SetLayout.Get()}, PreallocatedSets };
 
+    Array<const Shader *, 2> m_Shaders = {nullptr, nullptr};
+    Array<const Shader *, 2> m_BindlessShaders = {nullptr, nullptr};
     UniquePtr<GraphicsPipeline> m_Pipeline;
+    UniquePtr<GraphicsPipeline> m_BindlessPipeline;
     StructBuffer<MatricesUniform> m_MatricesUniformBuffer;
 
     UniquePtr<Sampler> m_DefaultSampler{
         Sampler::Create({})
     };
 
+    const Buffer *m_IndexBuffer = nullptr;
+
+    UniquePtr<Frame[]> m_Frames;
+    size_t m_FramesCount  = 0;
+    size_t m_CurrentFrame = 0;
+    size_t m_PrimitivesInBatch = DefaultPrimitivesInBatch;
+    // arenas are never trimmed below that
+    size_t m_ReservedPrimitives = DefaultPrimitivesInBatch;
+    size_t m_TrimFrames = DefaultTrimFrames;
+
     List<Batch> m_Batches;
+
+    List<const DrawRecorder *> m_Recorders;
+
+    UniquePtr<DescriptorSetPool> m_BindlessSetPool;
+    List<const Texture2D *> m_TextureTable;
+    size_t m_TableSize = 0;
+    bool m_IsTableExhausted = false;
+    std::unordered_map<const Texture2D *, u32> m_TextureTableIndices;
+    size_t m_TextureTableGeneration = 0;
+
+    List<UniquePtr<DescriptorSetPool>> m_CachedSetPools;
+    List<CachedSet> m_CachedSets;
+    // slots of set N are N * frames in flight + frame
+    List<CachedSlot> m_CachedSlots;
+    std::unordered_map<u64, size_t> m_CachedSetIndices;
+    size_t m_MaxCachedSets = DefaultMaxCachedSets;
+    size_t m_EvictionCursor = 0;
+    u64 m_CachedSetsGeneration = 0;
+    u64 m_FrameIndex = 0;
+
+    CullingBounds        m_CullingBounds;
+    ViewportCullingStats m_CullingStats;
+
+    RenderStats m_Stats;
+    RenderStats m_LastFrameStats;
+
+    DrawCapture *m_Capture = nullptr;
 public:
-    RectRenderer(const RenderPass *rp);
+    RectRenderer(const RenderPass *rp, size_t frames_in_flight = DefaultFramesInFlight, TexturingMode mode = TexturingMode::PerBatch, size_t primitives_in_batch = DefaultPrimitivesInBatch);
+
+    ~RectRenderer();
 
-    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture, const Array<Vector2f, 4> &texture_coords = s_DefaultTextureCoordinates);
+    // Texture coordinates of the rect's top-left and bottom-right corners, min greater than max flips the texture
+    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture, Vector2f tex_coords_min = {0.f, 0.f}, Vector2f tex_coords_max = {1.f, 1.f});
 
     void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color){
         DrawRect(position, size, origin, angle, color, Texture2D::White());
@@ -104,6 +287,75 @@ public:
         DrawRect(position, size, {0.f, 0.f}, 0, color, Texture2D::White());
     }
 
+    void DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, const AtlasRegion &region){
+        DrawRect(position, size, origin, angle, color, region.Page, region.TexCoordsMin, region.TexCoordsMax);
+    }
+
+    void DrawRect(Vector2f position, Vector2f size, Color color, const AtlasRegion &region){
+        DrawRect(position, size, {0.f, 0.f}, 0, color, region.Page, region.TexCoordsMin, region.TexCoordsMax);
+    }
+
+    // Bulk version of DrawRect(position, size, angle, color), rects are rotated around their center.
+    // All spans should be of the same size, empty angles span means no rotation
+    void DrawRects(ConstSpan<Vector2f> positions, ConstSpan<Vector2f> sizes, ConstSpan<float> angles, ConstSpan<Color> colors, Texture2D *texture = Texture2D::White());
+
+    // Preallocates upload memory of every frame for the given amount of rects, so drawing
+    // up to it never allocates GPU memory. Should be called when GPU isn't using the renderer.
+    // Preallocation is limited to QuadIndexBuffer::MaxQuadsCount, larger frames spill into extra chunks
+    void Reserve(size_t primitives);
+
+    // Upload memory grown by a spike is released once it stays at most half used
+    // for the given amount of frames, zero disables trimming
+    void SetTrimFrames(size_t frames){
+        m_TrimFrames = frames;
+    }
+
+    // Bindless mode keeps textures in the table until reset,
+    // so it should be reset before any of them is destroyed. Reset also ends PerBatch fallback
+    void ResetTextureTable();
+
+    // PerBatch mode caches descriptor sets by texture pointers, so it should be reset
+    // before any of cached textures is destroyed, as its address can be reused
+    void ResetSetCache();
+
+    // Cache grows with the number of texture combinations drawn up to this limit,
+    // past it combinations unused in the current frame are evicted. Already cached sets are kept
+    void SetMaxCachedSets(size_t count){
+        m_MaxCachedSets = count;
+    }
+
+    // Rects are drawn before the viewport is known, so culling is off until it's set.
+    // Rects entirely outside of it are dropped before they reach a batch
+    void SetCullingViewport(const ViewportParameters &viewport){
+        m_CullingBounds = CullingBounds::Centered(viewport.ViewportSize);
+    }
+
+    void DisableCulling(){
+        m_CullingBounds = {};
+    }
+
+    const ViewportCullingStats &CullingStats()const{
+        return m_CullingStats;
+    }
+
+    void ResetCullingStats(){
+        m_CullingStats = {};
+    }
+
+    // stats of the last frame finished by CmdRender, fence waits are always zero since
+    // frames are synchronized by the caller
+    const RenderStats &LastFrameStats()const{
+        return m_LastFrameStats;
+    }
+
+    // Every following call is serialized into capture until it's reset with nullptr
+    void SetCapture(DrawCapture *capture){
+        m_Capture = capture;
+    }
+
+    // Rects of submitted recorders are copied at CmdRender, after directly drawn ones, in submission order
+    void Submit(const DrawRecorder *recorder);
+
     void CmdRender(CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport);
 
     void CmdRender(CommandBuffer* cmd_buffer, const Framebuffer* fb) {
@@ -112,6 +364,56 @@ public:
         default_parameters.ViewportSize = Vector2f(fb->Size());
         CmdRender(cmd_buffer, fb, default_parameters);
     }
+
+    // Renderer2D this is attached to should have the same number
+    size_t FramesInFlight()const{
+        return m_FramesCount;
+    }
+private:
+    // replays captured rects through PushRect, so they keep their packed colors
+    friend class DrawCaptureReader;
+
+    void PushRect(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, const Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max);
+
+    void PushRects(const Vector2f *positions, const Vector2f *sizes, const float *angles, const Color *colors, size_t count, const Texture2D *texture);
+
+    bool IsVisible(Vector2f position, Vector2f size, float angle)const{
+        return m_CullingBounds.IsRectVisible(position, size, size / 2.f, angle);
+    }
+
+    void MergeRecorders();
+
+    void MergeRecorder(const DrawRecorder &recorder);
+
+    // batch of the current chunk with room for a rect and the given amount of textures it doesn't have yet
+    Batch &CurrentBatch(size_t new_textures);
+
+    // current batch once it can index all of the textures, a full table switches to PerBatch ones
+    Batch &BatchFor(ConstSpan<const Texture2D *> textures);
+
+    u32 TextureIndex(Batch &batch, const Texture2D *texture);
+
+    DescriptorSet *UpdateBindlessSet(const Buffer *instances);
+
+    DescriptorSet *WriteSpillBindlessSet(const Buffer *instances);
+
+    DescriptorSet *AcquireBatchSet(const Batch &batch, const Buffer *instances);
+
+    // index of a new or evicted cache entry, -1 when every one is used by the current frame
+    size_t ClaimCachedSet();
+
+    // single frame set, for batches the cache can't serve
+    DescriptorSet *WriteFrameBatchSet(const Batch &batch, const Buffer *instances);
+
+    void WriteBatchSet(DescriptorSet *set, const Batch &batch, const Buffer *instances, size_t written_textures);
+
+    void InvalidateCachedSets(const Buffer *instances);
+
+    void ReserveDevice(UploadArena &arena);
+
+    void TrimArena(UploadArena &arena, size_t reserved_primitives);
+
+    static void WriteInstances(RectInstance *instances, const Vector2f *positions, const Vector2f *sizes, const float *angles, const u32 *colors, size_t count, u32 texture_index);
 };
 
 #endif//STRAITX-2D_RECT_RENDERER_HPP
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef STRAITX_2D_RENDERER_2D_HPP
+#define STRAITX_2D_RENDERER_2D_HPP
+
+#include "core/list.hpp"
+#include "core/unique_ptr.hpp"
+#include "core/noncopyable.hpp"
+#include "core/assert.hpp"
+#include "graphics/api/fence.hpp"
+#include "graphics/api/semaphore.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/framebuffer.hpp"
+#include "graphics/api/buffer.hpp"
+#include "graphics/api/descriptor_set.hpp"
+#include "2d/common/viewport_parameters.hpp"
+#include "2d/common/frames_in_flight.hpp"
+
+class CircleRenderer;
+class LineRenderer;
+
+// Owns command buffers, fences, the view uniform and descriptor set pools of a frame ring
+// and submits everything attached renderers record with a single GPU::Execute per frame.
+// Anything with CmdRender(CommandBuffer*, const Framebuffer*, const ViewportParameters&)
+// can be attached, like RectRenderer or DrawQueue, CircleRenderer and LineRenderer
+// record into the context's command buffer and descriptor sets as well.
+// Attached objects rely on the context to synchronize their upload memory,
+// so they should have the same frames in flight
+class Renderer2D: public NonCopyable{
+public:
+    static constexpr size_t MaxSetsPerLayout = 256;
+private:
+    struct SetPoolSlot{
+        const DescriptorSetLayout *Layout = nullptr;
+        SingleFrameDescriptorSetPool *Pool = nullptr;
+    };
+
+    struct Frame{
+        CommandBuffer *CmdBuffer = nullptr;
+        Fence DrawingFence;
+        // ViewUniform of the frame's viewport
+        Buffer *ViewUniformBuffer = nullptr;
+        // created on the first allocation with a layout
+        List<SetPoolSlot> SetPools;
+    };
+
+    using RecordFunction = void (*)(void *renderer, Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport);
+    // lets renderers referencing the context forget it
+    using DetachFunction = void (*)(void *renderer);
+
+    struct Attachment{
+        void *Renderer = nullptr;
+        RecordFunction Record = nullptr;
+        DetachFunction Detach = nullptr;
+    };
+private:
+    UniquePtr<CommandPool> m_CmdPool;
+
+    UniquePtr<Frame[]> m_Frames;
+    size_t m_FramesCount  = 0;
+    size_t m_CurrentFrame = 0;
+    bool m_IsFrameBegun   = false;
+
+    List<Attachment> m_Attachments;
+
+    FramesInFlightStats m_FramesStats;
+public:
+    Renderer2D(size_t frames_in_flight = DefaultFramesInFlight);
+
+    ~Renderer2D();
+
+    // Renderers record at EndFrame in the order they were attached
+    template<typename RendererType>
+    void Attach(RendererType *renderer){
+        SX_CORE_ASSERT(renderer->FramesInFlight() == m_FramesCount, "Renderer2D: attached renderer should have the same frames in flight");
+
+        RecordFunction record = [](void *object, Renderer2D &, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+            static_cast<RendererType *>(object)->CmdRender(cmd_buffer, fb, viewport);
+        };
+        m_Attachments.Add({renderer, record, nullptr});
+    }
+
+    // Attached circles and lines are no longer submitted by EndDrawing, they are drawn
+    // into the context's frame with a draw per batch instead. Culling is disabled until
+    // their SetCullingViewport is called. They are detached when the context is destroyed
+    void Attach(CircleRenderer *renderer);
+
+    void Attach(LineRenderer *renderer);
+
+    void Detach(void *renderer);
+
+    // Waits until GPU is done with the frame's resources, attached renderers can be drawn into after that
+    void BeginFrame();
+
+    void EndFrame(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore, const Framebuffer *fb, const ViewportParameters &viewport);
+
+    void EndFrame(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore, const Framebuffer *fb){
+        ViewportParameters default_parameters;
+        default_parameters.ViewportOffset = {0.f, 0.f};
+        default_parameters.ViewportSize = Vector2f(fb->Size());
+        EndFrame(wait_semaphore, signal_semaphore, fb, default_parameters);
+    }
+
+    // set valid until the frame is drawn, should be called while recording
+    DescriptorSet *AllocSet(const DescriptorSetLayout *layout);
+
+    // ViewUniform of the frame being recorded
+    const Buffer *ViewUniformBuffer()const{
+        return m_Frames[m_CurrentFrame].ViewUniformBuffer;
+    }
+
+    const FramesInFlightStats &FramesStats()const{
+        return m_FramesStats;
+    }
+
+    void ResetFramesStats(){
+        m_FramesStats = {};
+    }
+};
+
+#endif//STRAITX_2D_RENDERER_2D_HPP
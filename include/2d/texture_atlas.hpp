@@ -0,0 +1,72 @@
+#ifndef STRAITX_2D_TEXTURE_ATLAS_HPP
+#define STRAITX_2D_TEXTURE_ATLAS_HPP
+
+#include "core/math/vector2.hpp"
+#include "core/list.hpp"
+#include "core/unique_ptr.hpp"
+#include "core/noncopyable.hpp"
+#include "graphics/api/texture.hpp"
+
+// Part of an atlas page, can be passed to RectRenderer::DrawRect instead of a texture
+struct AtlasRegion{
+    Texture2D *Page = nullptr;
+    Vector2f TexCoordsMin = {0.f, 0.f};
+    Vector2f TexCoordsMax = {1.f, 1.f};
+
+    bool IsValid()const{
+        return Page != nullptr;
+    }
+};
+
+// Packs many small RGBA8 images into a few large pages using skyline bottom-left packing.
+// Each image is surrounded by a Padding texels wide gutter of its extruded edges, so linear filtering doesn't bleed.
+// Pages are updated on the CPU and copied to their textures on Upload,
+// which should not be called while pages are still used by the GPU
+class TextureAtlas: public NonCopyable{
+public:
+    static constexpr u32 DefaultPageSize = 2048;
+    static constexpr u32 Padding = 1;
+private:
+    struct SkylineNode{
+        u32 X;
+        u32 Y;
+        u32 Width;
+    };
+
+    struct Page{
+        UniquePtr<u32[]> Pixels;
+        List<SkylineNode> Skyline;
+        Texture2D *Texture = nullptr;
+        bool IsDirty = false;
+
+        Page(u32 size);
+
+        ~Page();
+
+        bool Pack(u32 size, u32 width, u32 height, u32 &x, u32 &y);
+
+        void Insert(size_t index, u32 x, u32 y, u32 width, u32 height);
+    };
+
+    u32 m_PageSize = DefaultPageSize;
+    List<Page *> m_Pages;
+public:
+    TextureAtlas(u32 page_size = DefaultPageSize);
+
+    ~TextureAtlas();
+
+    // returns invalid region if image doesn't fit into a page
+    AtlasRegion Add(u32 width, u32 height, const u32 *rgba8_pixels);
+
+    void Upload();
+
+    size_t PagesCount()const{
+        return m_Pages.Size();
+    }
+
+    u32 PageSize()const{
+        return m_PageSize;
+    }
+};
+
+#endif//STRAITX_2D_TEXTURE_ATLAS_HPP
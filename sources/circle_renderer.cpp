@@ -1,5 +1,13 @@
 #include "2d/circle_renderer.hpp"
+#include "2d/draw_capture.hpp"
+#include "2d/draw_recorder.hpp"
+#include "2d/renderer_2d.hpp"
+#include "2d/common/shader_cache.hpp"
+#include "2d/common/static_buffer.hpp"
+#include "common/simd.hpp"
 #include "core/string.hpp"
+#include "core/assert.hpp"
+#include "core/os/memory.hpp"
 #include "core/math/functions.hpp"
 #include "core/math/linear.hpp"
 #include "graphics/api/command_buffer.hpp"
@@ -16,97 +24,145 @@ static const char *s_FragmentShader =
     #include "shaders/circle_renderer.frag.glsl"
 ;
 
-static Array<ShaderBinding, 1> s_ShaderBindings = {
-        ShaderBinding(0, 1,ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex)
+static Array<ShaderBinding, 2> s_ShaderBindings = {
+        ShaderBinding(0, 1,ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
+        ShaderBinding(1, 1,ShaderBindingType::StorageBuffer, ShaderStageBits::Vertex)
 };
 
-static Array<VertexAttribute, 4> s_VertexAttributes = {
-        VertexAttribute::Float32x2,
-        VertexAttribute::Float32x2,
-        VertexAttribute::UNorm8x4,
-        VertexAttribute::Float32x1,
-};
+static_assert(sizeof(CircleRenderer::CircleInstance) == 16, "CircleRenderer: CircleInstance should match std430 layout of the vertex shader");
 
 CircleRenderer::Batch::Batch(){
-    VerticesBuffer = Buffer::Create(sizeof(CircleVertex) * MaxVerticesInBatch, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
-    IndicesBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+    InstancesBuffer = Buffer::Create(sizeof(CircleInstance) * MaxCirclesInBatch, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+    DeviceInstances = Buffer::Create(sizeof(CircleInstance) * MaxCirclesInBatch, BufferMemoryType::DynamicVRAM, BufferUsageBits::StorageBuffer | BufferUsageBits::TransferDestination);
 
-    Vertices = VerticesBuffer->Map<CircleVertex>();
-    Indices  = IndicesBuffer->Map<u32>();
+    Instances = InstancesBuffer->Map<CircleInstance>();
 }
 
 CircleRenderer::Batch::~Batch(){
-    delete VerticesBuffer;
-    delete IndicesBuffer;
+    delete InstancesBuffer;
+    delete DeviceInstances;
 }
 
 void CircleRenderer::Batch::Reset(){
     SubmitedCirclesCount = 0;
 }
 
-CircleRenderer::CircleRenderer(const RenderPass *rp){
+CircleRenderer::Frame::Frame(){
+    Batches.Add(new Batch());
+}
+
+CircleRenderer::Frame::~Frame(){
+    for(Batch *batch: Batches)
+        delete batch;
+}
+
+CircleRenderer::StaticGeometry::StaticGeometry(const DrawRecorder &recorder):
+    m_CirclesCount(recorder.Circles().Size())
+{
+    if(!m_CirclesCount)
+        return;
+
+    m_Instances = CreateStaticBuffer(recorder.Circles().Pointer(), m_CirclesCount * sizeof(CircleInstance), BufferUsageBits::StorageBuffer);
+}
+
+CircleRenderer::StaticGeometry::~StaticGeometry(){
+    delete m_Instances;
+}
+
+CircleRenderer::CircleRenderer(const RenderPass *rp, size_t frames_in_flight):
+    m_Frames(new Frame[frames_in_flight]),
+    m_FramesCount(frames_in_flight)
+{
+    SX_CORE_ASSERT(frames_in_flight, "CircleRenderer: at least one frame in flight is required");
+
     m_FramebufferPass = rp;
 
     m_SetLayout = DescriptorSetLayout::Create(s_ShaderBindings);
 
-    m_SetPool = DescriptorSetPool::Create({1, m_SetLayout});
-    m_Set = m_SetPool->Alloc();
-
-    m_Shaders[0] = Shader::Create(ShaderStageBits::Vertex,   {s_VertexShader,   String::Length(s_VertexShader)  } );
-    m_Shaders[1] = Shader::Create(ShaderStageBits::Fragment, {s_FragmentShader, String::Length(s_FragmentShader)} );
+    m_Shaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_VertexShader);
+    m_Shaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_FragmentShader);
 
     {
         GraphicsPipelineProperties props;
         props.Shaders = m_Shaders;
-        props.VertexAttributes = s_VertexAttributes;
         props.Pass = m_FramebufferPass;
         props.Layout = m_SetLayout;
 
         m_Pipeline = GraphicsPipeline::Create(props);
     }
-
-    m_CmdPool = CommandPool::Create();
-    m_CmdBuffer = m_CmdPool->Alloc();
-
-    m_VertexBuffer = Buffer::Create(sizeof(CircleVertex) * MaxVerticesInBatch, BufferMemoryType::DynamicVRAM, BufferUsageBits::VertexBuffer | BufferUsageBits::TransferDestination);
-    m_IndexBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::DynamicVRAM, BufferUsageBits::IndexBuffer  | BufferUsageBits::TransferDestination);
-    m_MatricesUniformBuffer = Buffer::Create(sizeof(MatricesUniform), BufferMemoryType::DynamicVRAM, BufferUsageBits::UniformBuffer | BufferUsageBits::TransferSource);
-
-    m_Set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
-
-    m_DrawingFence.Signal();
 }
 
 CircleRenderer::~CircleRenderer(){
-    m_DrawingFence.WaitFor();
+    if(m_Submissions){
+        for(size_t i = 0; i<m_FramesCount; i++){
+            Submission &submission = m_Submissions[i];
 
-    delete m_VertexBuffer;
-    delete m_IndexBuffer;
-    delete m_MatricesUniformBuffer;
+            submission.DrawingFence.WaitFor();
 
-    m_CmdPool->Free(m_CmdBuffer);
-    delete m_CmdPool;
+            for(ViewportSlot &slot: submission.Viewports){
+                delete slot.MatricesUniformBuffer;
+                m_SetPool->Free(slot.Set);
+            }
+
+            m_CmdPool->Free(submission.CmdBuffer);
+        }
+    }
 
     delete m_Pipeline;
 
     for(auto shader: m_Shaders)
-        delete shader;
+        ShaderCache::Release(shader);
 
-    m_SetPool->Free(m_Set);
-    delete m_SetPool;
+    m_Submissions = nullptr;
+    m_SetPool = nullptr;
     delete m_SetLayout;
 }
 
-Result CircleRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport){
+void CircleRenderer::CreateSubmissions(){
+    m_CmdPool = CommandPool::Create();
+    m_SetPool = DescriptorSetPool::Create({m_FramesCount * MaxViewports, m_SetLayout});
+    m_Submissions = new Submission[m_FramesCount];
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        Submission &submission = m_Submissions[i];
+
+        submission.CmdBuffer = m_CmdPool->Alloc();
+
+        for(ViewportSlot &slot: submission.Viewports){
+            slot.Set = m_SetPool->Alloc();
+            slot.MatricesUniformBuffer = Buffer::Create(sizeof(ViewUniform), BufferMemoryType::DynamicVRAM, BufferUsageBits::UniformBuffer | BufferUsageBits::TransferSource);
+            slot.Set->UpdateUniformBinding(0, 0, slot.MatricesUniformBuffer);
+        }
+
+        submission.DrawingFence.Signal();
+    }
+}
+
+Result CircleRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, ConstSpan<ViewportParameters> viewports){
+    SX_CORE_ASSERT(viewports.Size() && viewports.Size() <= MaxViewports, "CircleRenderer: from 1 to MaxViewports viewports are supported");
+    SX_CORE_ASSERT(!m_Context, "CircleRenderer: Renderer attached to Renderer2D is drawn by its EndFrame");
+
+    if(!m_Submissions)
+        CreateSubmissions();
+
     m_Framebuffer = framebuffer;
-    m_CurrentViewport = viewport;
+    m_FramebufferSize = Vector2f(framebuffer->Size());
+
+    // capture format keeps a single viewport per frame, so only the first one is recorded
+    if(m_Capture)
+        m_Capture->Boundary(DrawCommandType::CirclesBegin, framebuffer->Size(), viewports[0]);
 
     m_SemaphoreRing.Begin(wait_semaphore);
 
-    m_BatcheRings.Current().Reset();
+    CurrentFrame().Staging().Reset();
+
+    m_Viewports.Clear();
+    for(size_t i = 0; i<viewports.Size(); i++){
+        m_ViewportUniforms[i] = ViewUniform::Make(framebuffer->Size(), viewports[i]);
+        m_Viewports.Add(viewports[i]);
+    }
 
-    m_MatricesUniform.u_Projection[0][0] = 2.f/framebuffer->Size().x;
-    m_MatricesUniform.u_Projection[1][1] = 2.f/framebuffer->Size().y;
+    m_CullingBounds = CullingBounds::Centered(Vector2f(framebuffer->Size()));
 
     //XXX Check if framebuffer matches RenderPass
     return Result::Success;
@@ -120,84 +176,359 @@ Result CircleRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Frame
 }
 
 void CircleRenderer::EndDrawing(const Semaphore *signal_semaphore){
+    SX_CORE_ASSERT(!m_Context, "CircleRenderer: Renderer attached to Renderer2D is drawn by its EndFrame");
+
+    MergeRecorders();
+
+    if(m_Capture)
+        m_Capture->Boundary(DrawCommandType::CirclesEnd);
+
     Flush(m_SemaphoreRing.Current(), signal_semaphore);
 
     m_SemaphoreRing.End();
+
+    m_LastFrameStats = m_Stats;
+    m_Stats = {};
 }
 
 
 void CircleRenderer::DrawCircle(Vector2s center, float radius, Color color){
-    if(m_BatcheRings.Current().IsGeometryFull())
-        Flush();
+    if(m_Capture)
+        m_Capture->Circle(center, radius, color);
+
+    m_CullingStats.Submitted++;
+
+    if(!IsVisible(Vector2f(center), radius)){
+        m_CullingStats.Culled++;
+        return;
+    }
+
+    Batch &batch = BatchWithRoom();
+
+    batch.Instances[batch.SubmitedCirclesCount] = {Vector2f(center), radius, color.RGBA8()};
+
+    batch.SubmitedCirclesCount++;
 
-    Batch &batch = m_BatcheRings.Current();
+    SX_2D_STATS(m_Stats.Primitives++);
+}
+
+void CircleRenderer::DrawCircles(ConstSpan<Vector2f> centers, ConstSpan<float> radii, ConstSpan<Color> colors){
+    const size_t count = centers.Size();
+
+    SX_CORE_ASSERT(radii.Size() == count && colors.Size() == count, "CircleRenderer: DrawCircles spans should be of the same size");
 
-    size_t base_vertex = batch.SubmitedCirclesCount * 4;
-    size_t base_index  = batch.SubmitedCirclesCount * 6;
+    if(m_Capture)
+        m_Capture->Circles(centers, radii, colors);
 
-    Array<Vector2f, 4> vertices = {
-            Vector2f(center) + Vector2f(-radius,-radius),
-            Vector2f(center) + Vector2f( radius,-radius),
-            Vector2f(center) + Vector2f( radius, radius),
-            Vector2f(center) + Vector2f(-radius, radius)
-    };
+    m_CullingStats.Submitted += count;
 
-    Vector2f offset = Vector2f(m_Framebuffer->Size()/2u) - m_CurrentViewport.Offset;
+    // visible circles are pushed in runs to keep the bulk path for them
+    size_t first = 0;
+    while(first < count){
+        size_t last = first;
+        while(last < count && IsVisible(centers[last], radii[last]))
+            last++;
 
-    for(auto &vertex: vertices){
-        vertex *= m_CurrentViewport.Scale;
-        vertex -= offset;
+        PushCircles(centers.Pointer() + first, radii.Pointer() + first, colors.Pointer() + first, last - first);
+
+        first = last;
+        while(first < count && !IsVisible(centers[first], radii[first])){
+            m_CullingStats.Culled++;
+            first++;
+        }
     }
+}
 
-    batch.Vertices[base_vertex + 0] = {vertices[0], Vector2f(-radius,-radius), color.RGBA8(), radius};
-    batch.Vertices[base_vertex + 1] = {vertices[1], Vector2f( radius,-radius), color.RGBA8(), radius};
-    batch.Vertices[base_vertex + 2] = {vertices[2], Vector2f( radius, radius), color.RGBA8(), radius};
-    batch.Vertices[base_vertex + 3] = {vertices[3], Vector2f(-radius, radius), color.RGBA8(), radius};
+void CircleRenderer::SetCullingViewport(Vector2u framebuffer_size, const ViewportParameters &viewport){
+    m_FramebufferSize = Vector2f(framebuffer_size);
+    m_CullingBounds = CullingBounds::Centered(m_FramebufferSize);
 
-    batch.Indices[base_index + 0] = batch.SubmitedCirclesCount * 4 + 0;
-    batch.Indices[base_index + 1] = batch.SubmitedCirclesCount * 4 + 1;
-    batch.Indices[base_index + 2] = batch.SubmitedCirclesCount * 4 + 2;
+    m_Viewports.Clear();
+    m_Viewports.Add(viewport);
+}
 
-    batch.Indices[base_index + 3] = batch.SubmitedCirclesCount * 4 + 2;
-    batch.Indices[base_index + 4] = batch.SubmitedCirclesCount * 4 + 3;
-    batch.Indices[base_index + 5] = batch.SubmitedCirclesCount * 4 + 0;
+bool CircleRenderer::IsVisible(Vector2f center, float radius)const{
+    if(!m_CullingBounds.Enabled)
+        return true;
 
-    batch.SubmitedCirclesCount++;
+    for(const ViewportParameters &viewport: m_Viewports){
+        Vector2f offset = Vector2f(Vector2u(m_FramebufferSize)/2u) - viewport.Offset;
+        Vector2f extent = {Math::Abs(radius * viewport.Scale.x), Math::Abs(radius * viewport.Scale.y)};
+
+        if(m_CullingBounds.IsCircleVisible(center * viewport.Scale - offset, extent))
+            return true;
+    }
+    return false;
+}
+
+void CircleRenderer::PushCircles(const Vector2f *centers, const float *radii, const Color *colors, size_t count){
+    static constexpr size_t ColorsChunk = 256;
+    u32 packed_colors[ColorsChunk];
+
+    size_t submitted = 0;
+    while(submitted < count){
+        Batch &batch = BatchWithRoom();
+
+        const size_t chunk = Math::Min(count - submitted, Math::Min(MaxCirclesInBatch - batch.SubmitedCirclesCount, ColorsChunk));
+
+        {
+            SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+
+            PackColorsRGBA8(colors + submitted, packed_colors, chunk);
+
+            WriteInstances(batch.Instances + batch.SubmitedCirclesCount, centers + submitted, radii + submitted, packed_colors, chunk);
+        }
+
+        batch.SubmitedCirclesCount += chunk;
+        submitted += chunk;
+    }
+
+    SX_2D_STATS(m_Stats.Primitives += count);
+}
+
+void CircleRenderer::WriteInstances(CircleInstance *instances, const Vector2f *centers, const float *radii, const u32 *colors, size_t count){
+    size_t i = 0;
+#if SX_2D_SIMD_SSE2
+    static_assert(sizeof(Vector2f) == sizeof(float) * 2, "CircleRenderer: WriteInstances relies on Vector2f layout");
+
+    // two circles per iteration, each CircleInstance is exactly one register
+    for(; i + 2 <= count; i += 2){
+        __m128 center = _mm_loadu_ps((const float *)(centers + i));
+        __m128 radius = _mm_castpd_ps(_mm_load_sd((const double *)(radii + i)));
+        __m128 color  = _mm_castpd_ps(_mm_load_sd((const double *)(colors + i)));
+
+        __m128 radius_color = _mm_unpacklo_ps(radius, color);
+
+        _mm_storeu_ps((float *)(instances + i + 0), _mm_movelh_ps(center, radius_color));
+        _mm_storeu_ps((float *)(instances + i + 1), _mm_movehl_ps(radius_color, center));
+    }
+#endif
+    for(; i < count; i++)
+        instances[i] = {centers[i], radii[i], colors[i]};
+}
+
+void CircleRenderer::DrawStatic(const StaticGeometry &geometry){
+    if(m_Context){
+        RecordPendingCircles();
+
+        if(geometry.m_CirclesCount)
+            m_RecordedDraws.Add({geometry.m_Instances, 0, geometry.m_CirclesCount});
+
+        SX_2D_STATS(m_Stats.Primitives += geometry.m_CirclesCount);
+        return;
+    }
+
+    if(CurrentFrame().Staging().SubmitedCirclesCount)
+        Flush();
+
+    if(!geometry.m_CirclesCount)
+        return;
+
+    SubmitDraw(nullptr, geometry.m_Instances, geometry.m_CirclesCount, m_SemaphoreRing.Current(), m_SemaphoreRing.Next());
+    m_SemaphoreRing.Advance();
+
+    SX_2D_STATS(m_Stats.Primitives += geometry.m_CirclesCount);
 }
 
 void CircleRenderer::Flush(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore){
-    m_DrawingFence.WaitAndReset();
+    Batch &batch = CurrentFrame().Staging();
+
+    SubmitDraw(batch.InstancesBuffer, batch.DeviceInstances, batch.SubmitedCirclesCount, wait_semaphore, signal_semaphore);
+}
+
+void CircleRenderer::SubmitDraw(const Buffer *staging, Buffer *instances, size_t circles_count, const Semaphore *wait_semaphore, const Semaphore *signal_semaphore){
+    Submission &frame = CurrentSubmission();
+
+    {
+        SX_2D_STATS_TIMER(m_Stats.FenceWaitNanoseconds);
+        // frame was already waited for when it became current, this only resets the fence
+        frame.DrawingFence.WaitAndReset();
+    }
+
+    for(size_t i = 0; i<m_Viewports.Size(); i++){
+        ViewportSlot &slot = frame.Viewports[i];
+
+        slot.MatricesUniformBuffer->Copy(&m_ViewportUniforms[i], sizeof(ViewUniform));
+        SX_2D_STATS(m_Stats.BytesUploaded += sizeof(ViewUniform));
+
+        if(slot.BoundInstances != instances){
+            slot.Set->UpdateStorageBufferBinding(1, 0, instances);
+            slot.BoundInstances = instances;
+            SX_2D_STATS(m_Stats.DescriptorWrites++);
+        }
+    }
+
+    frame.CmdBuffer->Reset();
+    frame.CmdBuffer->Begin();
+
+    if(staging && circles_count){
+        frame.CmdBuffer->Copy(staging, instances, circles_count * sizeof(CircleInstance));
+        SX_2D_STATS(m_Stats.BytesUploaded += circles_count * sizeof(CircleInstance));
+    }
+
+    if(circles_count){
+        frame.CmdBuffer->Bind(m_Pipeline);
+        frame.CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
+        for(size_t i = 0; i<m_Viewports.Size(); i++){
+            const ViewportParameters &viewport = m_Viewports[i];
+
+            frame.CmdBuffer->SetScissor (viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+            frame.CmdBuffer->SetViewport(viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+            frame.CmdBuffer->Bind(frame.Viewports[i].Set);
+            frame.CmdBuffer->Draw(circles_count * 6);
+        }
+        frame.CmdBuffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.DrawCalls += m_Viewports.Size());
+    }
+
+    frame.CmdBuffer->End();
+
+    GPU::Execute(frame.CmdBuffer, *wait_semaphore, *signal_semaphore, frame.DrawingFence);
+
+    m_FramesStats.SubmittedFrames++;
+    SX_2D_STATS(m_Stats.Batches++);
+
+    AdvanceFrame();
+}
+
+void CircleRenderer::AdvanceFrame(){
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+
+    Submission &submission = CurrentSubmission();
+
+    if(!submission.DrawingFence.IsSignaled())
+        m_FramesStats.RingExhausted++;
+    {
+        SX_2D_STATS_TIMER(m_Stats.FenceWaitNanoseconds);
+        // staging memory of this frame can't be touched until GPU is done copying from it
+        submission.DrawingFence.WaitFor();
+    }
+
+    CurrentFrame().Staging().Reset();
+}
+
+CircleRenderer::Batch &CircleRenderer::BatchWithRoom(){
+    if(!CurrentFrame().Staging().IsGeometryFull())
+        return CurrentFrame().Staging();
+
+    if(!m_Context){
+        Flush();
+        return CurrentFrame().Staging();
+    }
+
+    RecordPendingCircles();
+
+    Frame &frame = CurrentFrame();
+    if(++frame.CurrentBatch == frame.Batches.Size())
+        frame.Batches.Add(new Batch());
+
+    frame.Staging().Reset();
+    m_RecordedCircles = 0;
+
+    return frame.Staging();
+}
+
+void CircleRenderer::RecordPendingCircles(){
+    Batch &batch = CurrentFrame().Staging();
+
+    if(batch.SubmitedCirclesCount == m_RecordedCircles)
+        return;
+
+    m_RecordedDraws.Add({batch.DeviceInstances, m_RecordedCircles, batch.SubmitedCirclesCount - m_RecordedCircles});
+    m_RecordedCircles = batch.SubmitedCirclesCount;
+}
+
+void CircleRenderer::CmdRender(Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+    MergeRecorders();
+    RecordPendingCircles();
 
-    Batch &batch = m_BatcheRings.Current();
+    Frame &frame = CurrentFrame();
 
-    m_MatricesUniformBuffer->Copy(&m_MatricesUniform, sizeof(m_MatricesUniform));
+    for(size_t i = 0; i<=frame.CurrentBatch; i++){
+        const Batch &batch = *frame.Batches[i];
 
-    m_CmdBuffer->Reset();
-    m_CmdBuffer->Begin();
+        if(!batch.SubmitedCirclesCount)
+            continue;
 
-    if(batch.SubmitedCirclesCount){
-        m_CmdBuffer->Copy(batch.VerticesBuffer, m_VertexBuffer, batch.SubmitedCirclesCount * 4 * sizeof(CircleVertex));
-        m_CmdBuffer->Copy(batch.IndicesBuffer, m_IndexBuffer, batch.SubmitedCirclesCount * 6 * sizeof(u32));
-        m_CmdBuffer->SetScissor (m_CurrentViewport.ViewportOffset.x, m_CurrentViewport.ViewportOffset.y, m_CurrentViewport.ViewportSize.x, m_CurrentViewport.ViewportSize.y);
-        m_CmdBuffer->SetViewport(m_CurrentViewport.ViewportOffset.x, m_CurrentViewport.ViewportOffset.y, m_CurrentViewport.ViewportSize.x, m_CurrentViewport.ViewportSize.y);
-        m_CmdBuffer->Bind(m_Pipeline);
-        m_CmdBuffer->Bind(m_Set);
-        m_CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
-            m_CmdBuffer->BindVertexBuffer(m_VertexBuffer);
-            m_CmdBuffer->BindIndexBuffer(m_IndexBuffer, IndicesType::Uint32);
-            m_CmdBuffer->DrawIndexed(batch.SubmitedCirclesCount * 6);
-        m_CmdBuffer->EndRenderPass();
+        cmd_buffer->Copy(batch.InstancesBuffer, batch.DeviceInstances, batch.SubmitedCirclesCount * sizeof(CircleInstance));
+        SX_2D_STATS(m_Stats.BytesUploaded += batch.SubmitedCirclesCount * sizeof(CircleInstance));
     }
 
-    m_CmdBuffer->End();
+    if(m_RecordedDraws.Size()){
+        cmd_buffer->Bind(m_Pipeline);
+        cmd_buffer->BeginRenderPass(m_FramebufferPass, fb);
+        cmd_buffer->SetScissor (viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+        cmd_buffer->SetViewport(viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+
+        // batches spilled past MaxCirclesInBatch and static geometry are separate draws of the same pass
+        const Buffer *bound_instances = nullptr;
+        for(const RecordedDraw &draw: m_RecordedDraws){
+            if(bound_instances != draw.Instances){
+                bound_instances = draw.Instances;
+
+                DescriptorSet *set = context.AllocSet(m_SetLayout);
+                set->UpdateUniformBinding(0, 0, context.ViewUniformBuffer());
+                set->UpdateStorageBufferBinding(1, 0, draw.Instances);
+                cmd_buffer->Bind(set);
+                SX_2D_STATS(m_Stats.DescriptorWrites += 2);
+            }
+
+            cmd_buffer->Draw(draw.CirclesCount * 6, draw.FirstCircle * 6);
+        }
+        cmd_buffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.DrawCalls += m_RecordedDraws.Size());
+    }
+
+    SX_2D_STATS(m_Stats.Batches += frame.CurrentBatch + 1);
+
+    m_RecordedDraws.Clear();
+    m_RecordedCircles = 0;
 
-    GPU::Execute(m_CmdBuffer, *wait_semaphore, *signal_semaphore, m_DrawingFence);
+    // context has already waited for the next frame when it gets drawn into
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+    CurrentFrame().CurrentBatch = 0;
+    CurrentFrame().Staging().Reset();
+
+    m_LastFrameStats = m_Stats;
+    m_Stats = {};
+}
 
-    batch.Reset();
-    m_BatcheRings.Advance();
+void CircleRenderer::Submit(const DrawRecorder *recorder){
+    m_Recorders.Add(recorder);
+}
+
+void CircleRenderer::MergeRecorders(){
+    for(const DrawRecorder *recorder: m_Recorders)
+        CopyInstances(recorder->Circles().Pointer(), recorder->Circles().Size());
+
+    m_Recorders.Clear();
+}
+
+void CircleRenderer::CopyInstances(const CircleInstance *instances, size_t count){
+    size_t copied = 0;
+    while(copied < count){
+        Batch &batch = BatchWithRoom();
+
+        const size_t chunk = Math::Min(count - copied, MaxCirclesInBatch - batch.SubmitedCirclesCount);
+
+        Memory::Copy(instances + copied, batch.Instances + batch.SubmitedCirclesCount, chunk * sizeof(CircleInstance));
+
+        batch.SubmitedCirclesCount += chunk;
+        copied += chunk;
+    }
+
+    SX_2D_STATS(m_Stats.Primitives += count);
 }
 
 void CircleRenderer::Flush() {
+    // attached renderer is submitted by Renderer2D's EndFrame
+    if(m_Context){
+        RecordPendingCircles();
+        return;
+    }
+
     Flush(m_SemaphoreRing.Current(), m_SemaphoreRing.Next());
     m_SemaphoreRing.Advance();
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef STRAITX_2D_COMMON_DECIMATION_HPP
+#define STRAITX_2D_COMMON_DECIMATION_HPP
+
+#include <cmath>
+#include "core/types.hpp"
+#include "core/span.hpp"
+#include "core/math/vector2.hpp"
+
+// Reduces every run of consecutive points falling into the same pixel column to its first,
+// lowest, highest and last point, in their original order (M4 aggregation). Strips rasterize
+// the same since every column still spans the same vertical range and runs stay connected.
+// Column of a point is floor((x - offset_x) * scale_x), emit is called with kept points
+template<typename EmitType>
+void DecimateByColumns(ConstSpan<Vector2s> points, float offset_x, float scale_x, EmitType &&emit){
+    auto column_of = [&](size_t i){
+        return (s64)std::floor((points[i].x - offset_x) * scale_x);
+    };
+
+    size_t first = 0;
+    while(first < points.Size()){
+        const s64 column = column_of(first);
+
+        size_t lowest = first;
+        size_t highest = first;
+        size_t last = first + 1;
+        for(; last < points.Size() && column_of(last) == column; last++){
+            if(points[last].y < points[lowest].y)
+                lowest = last;
+            if(points[last].y > points[highest].y)
+                highest = last;
+        }
+        last--;
+
+        size_t kept[4] = {first, lowest, highest, last};
+        // sort four indices to keep the original order, duplicates end up adjacent
+        for(size_t i = 1; i<4; i++){
+            for(size_t j = i; j > 0 && kept[j - 1] > kept[j]; j--){
+                size_t index = kept[j];
+                kept[j] = kept[j - 1];
+                kept[j - 1] = index;
+            }
+        }
+
+        for(size_t i = 0; i<4; i++){
+            if(!i || kept[i] != kept[i - 1])
+                emit(points[kept[i]]);
+        }
+
+        first = last + 1;
+    }
+}
+
+#endif//STRAITX_2D_COMMON_DECIMATION_HPP
@@ -0,0 +1,54 @@
+#ifndef STRAITX_2D_COMMON_PACKING_HPP
+#define STRAITX_2D_COMMON_PACKING_HPP
+
+#include "core/types.hpp"
+#include "core/os/memory.hpp"
+
+// Round to nearest even IEEE half, overflow goes to infinity, NaN stays NaN and denormals are flushed to zero.
+// Matches unpackHalf2x16 of GLSL
+inline u16 PackHalf(float value){
+    u32 bits;
+    Memory::Copy(&value, &bits, sizeof(bits));
+
+    const u32 sign = (bits >> 16) & 0x8000;
+    const s32 exponent = (s32)((bits >> 23) & 0xFF) - 127 + 15;
+    const u32 mantissa = bits & 0x7FFFFF;
+
+    // quiet bit is set, so NaNs with only low payload bits don't turn into infinity
+    if(exponent == 0xFF - 127 + 15 && mantissa)
+        return (u16)(sign | 0x7E00 | (mantissa >> 13));
+    if(exponent <= 0)
+        return (u16)sign;
+    if(exponent >= 31)
+        return (u16)(sign | 0x7C00);
+
+    u32 half = sign | ((u32)exponent << 10) | (mantissa >> 13);
+    // ties go to even mantissa, carry into exponent is fine, it rounds up to the next power of two
+    if((mantissa & 0x1000) && (mantissa & 0x2FFF))
+        half++;
+    return (u16)half;
+}
+
+inline u32 PackHalf2x16(float x, float y){
+    return (u32)PackHalf(x) | ((u32)PackHalf(y) << 16);
+}
+
+inline u16 PackUnorm16(float value){
+    value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+    return (u16)(value * 65535.f + 0.5f);
+}
+
+inline u32 PackUnorm2x16(float x, float y){
+    return (u32)PackUnorm16(x) | ((u32)PackUnorm16(y) << 16);
+}
+
+inline u16 PackSnorm16(float value){
+    value = value < -1.f ? -1.f : (value > 1.f ? 1.f : value);
+    return (u16)(s16)(value * 32767.f + (value < 0.f ? -0.5f : 0.5f));
+}
+
+inline u32 PackSnorm2x16(float x, float y){
+    return (u32)PackSnorm16(x) | ((u32)PackSnorm16(y) << 16);
+}
+
+#endif//STRAITX_2D_COMMON_PACKING_HPP
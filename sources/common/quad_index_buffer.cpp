@@ -0,0 +1,39 @@
+#include "2d/common/quad_index_buffer.hpp"
+#include "2d/common/static_buffer.hpp"
+#include "core/assert.hpp"
+#include "core/unique_ptr.hpp"
+
+static Buffer *s_QuadIndexBuffer = nullptr;
+static size_t s_ReferencesCount = 0;
+
+static Buffer *CreateQuadIndexBuffer(){
+    UniquePtr<u32[]> indices(new u32[QuadIndexBuffer::MaxIndicesCount]);
+
+    for(u32 i = 0; i < QuadIndexBuffer::MaxQuadsCount; i++){
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 2;
+
+        indices[i * 6 + 3] = i * 4 + 2;
+        indices[i * 6 + 4] = i * 4 + 3;
+        indices[i * 6 + 5] = i * 4 + 0;
+    }
+
+    return CreateStaticBuffer(indices.Get(), sizeof(u32) * QuadIndexBuffer::MaxIndicesCount, BufferUsageBits::IndexBuffer);
+}
+
+const Buffer *QuadIndexBuffer::Acquire(){
+    if(!s_ReferencesCount++)
+        s_QuadIndexBuffer = CreateQuadIndexBuffer();
+
+    return s_QuadIndexBuffer;
+}
+
+void QuadIndexBuffer::Release(){
+    SX_CORE_ASSERT(s_ReferencesCount, "QuadIndexBuffer: Release without Acquire");
+
+    if(!--s_ReferencesCount){
+        delete s_QuadIndexBuffer;
+        s_QuadIndexBuffer = nullptr;
+    }
+}
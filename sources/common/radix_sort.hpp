@@ -0,0 +1,42 @@
+#ifndef STRAITX_2D_COMMON_RADIX_SORT_HPP
+#define STRAITX_2D_COMMON_RADIX_SORT_HPP
+
+#include "core/types.hpp"
+#include "core/os/memory.hpp"
+
+// Stable LSD radix sort of items by their upper 32 bits, lower ones are a payload.
+// Result ends up in items, scratch should have the same size. Bytes that are equal
+// across all the keys are skipped, so sorting mostly uniform keys is cheap
+inline void RadixSortByKey(u64 *items, u64 *scratch, size_t count){
+    u64 *source = items;
+    u64 *destination = scratch;
+
+    for(u32 shift = 32; shift < 64; shift += 8){
+        size_t offsets[256] = {};
+
+        for(size_t i = 0; i<count; i++)
+            offsets[(source[i] >> shift) & 0xFF]++;
+
+        if(count && offsets[(source[0] >> shift) & 0xFF] == count)
+            continue;
+
+        size_t sum = 0;
+        for(size_t &offset: offsets){
+            size_t digit_count = offset;
+            offset = sum;
+            sum += digit_count;
+        }
+
+        for(size_t i = 0; i<count; i++)
+            destination[offsets[(source[i] >> shift) & 0xFF]++] = source[i];
+
+        u64 *sorted = destination;
+        destination = source;
+        source = sorted;
+    }
+
+    if(source != items)
+        Memory::Copy(source, items, count * sizeof(u64));
+}
+
+#endif//STRAITX_2D_COMMON_RADIX_SORT_HPP
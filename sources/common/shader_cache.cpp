@@ -0,0 +1,202 @@
+#include "2d/common/shader_cache.hpp"
+#include "core/assert.hpp"
+#include "core/string.hpp"
+#include "core/list.hpp"
+#include "core/unique_ptr.hpp"
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+
+#if SX_2D_PRECOMPILED_SHADERS
+    #include <cstdint>
+    #include "shaders/rect_renderer.vert.spv.h"
+    #include "shaders/rect_renderer_compact.vert.spv.h"
+    #include "shaders/rect_renderer.frag.spv.h"
+    #include "shaders/rect_renderer_bindless.frag.spv.h"
+    #include "shaders/circle_renderer.vert.spv.h"
+    #include "shaders/circle_renderer.frag.spv.h"
+    #include "shaders/line_renderer.vert.spv.h"
+    #include "shaders/line_renderer.frag.spv.h"
+    #include "shaders/line_renderer_expanded.vert.spv.h"
+    #include "shaders/line_renderer_expanded.frag.spv.h"
+#endif
+
+namespace {
+
+struct CachedShader{
+    ShaderStageBits::Value Stage;
+    const char *Sources = nullptr;
+    const Shader *Module = nullptr;
+    size_t ReferencesCount = 0;
+};
+
+#if SX_2D_PRECOMPILED_SHADERS
+struct ShaderBinary{
+    const char *Sources;
+    ConstSpan<u32> Binary;
+};
+#endif
+
+}//namespace
+
+#if SX_2D_PRECOMPILED_SHADERS
+// binaries are matched to embedded sources by content, like cached shaders are
+static const ShaderBinary s_Binaries[] = {
+    {
+        #include "shaders/rect_renderer.vert.glsl"
+        , {rect_renderer_vert_spirv, lengthof(rect_renderer_vert_spirv)}
+    },
+    {
+        #include "shaders/rect_renderer_compact.vert.glsl"
+        , {rect_renderer_compact_vert_spirv, lengthof(rect_renderer_compact_vert_spirv)}
+    },
+    {
+        #include "shaders/rect_renderer.frag.glsl"
+        , {rect_renderer_frag_spirv, lengthof(rect_renderer_frag_spirv)}
+    },
+    {
+        #include "shaders/rect_renderer_bindless.frag.glsl"
+        , {rect_renderer_bindless_frag_spirv, lengthof(rect_renderer_bindless_frag_spirv)}
+    },
+    {
+        #include "shaders/circle_renderer.vert.glsl"
+        , {circle_renderer_vert_spirv, lengthof(circle_renderer_vert_spirv)}
+    },
+    {
+        #include "shaders/circle_renderer.frag.glsl"
+        , {circle_renderer_frag_spirv, lengthof(circle_renderer_frag_spirv)}
+    },
+    {
+        #include "shaders/line_renderer.vert.glsl"
+        , {line_renderer_vert_spirv, lengthof(line_renderer_vert_spirv)}
+    },
+    {
+        #include "shaders/line_renderer.frag.glsl"
+        , {line_renderer_frag_spirv, lengthof(line_renderer_frag_spirv)}
+    },
+    {
+        #include "shaders/line_renderer_expanded.vert.glsl"
+        , {line_renderer_expanded_vert_spirv, lengthof(line_renderer_expanded_vert_spirv)}
+    },
+    {
+        #include "shaders/line_renderer_expanded.frag.glsl"
+        , {line_renderer_expanded_frag_spirv, lengthof(line_renderer_expanded_frag_spirv)}
+    },
+};
+#endif
+
+// there is a handful of shaders, so linear search is fine
+static List<CachedShader> s_Shaders;
+// renderers may be created and destroyed on several threads
+static std::mutex s_ShadersLock;
+
+static ShaderCacheHooks s_Hooks;
+
+static ConstSpan<u32> FindBinary(const char *sources){
+#if SX_2D_PRECOMPILED_SHADERS
+    for(const ShaderBinary &binary: s_Binaries){
+        if(binary.Sources == sources || std::strcmp(binary.Sources, sources) == 0)
+            return binary.Binary;
+    }
+#else
+    (void)sources;
+#endif
+    return {};
+}
+
+static const Shader *CreateShader(ShaderStageBits::Value stage, const char *sources){
+    ConstSpan<u32> binary = FindBinary(sources);
+
+    if(s_Hooks.CreateFromBinary && binary.Size()){
+        if(const Shader *module = s_Hooks.CreateFromBinary(stage, binary))
+            return module;
+    }
+
+    return Shader::Create(stage, {sources, String::Length(sources)});
+}
+
+void ShaderCache::SetHooks(const ShaderCacheHooks &hooks){
+    std::lock_guard<std::mutex> lock(s_ShadersLock);
+
+    s_Hooks = hooks;
+}
+
+const Shader *ShaderCache::Acquire(ShaderStageBits::Value stage, const char *sources){
+    std::lock_guard<std::mutex> lock(s_ShadersLock);
+
+    for(CachedShader &cached: s_Shaders){
+        if(cached.Stage != stage)
+            continue;
+        // the same file is embedded separately into every translation unit including it
+        if(cached.Sources != sources && std::strcmp(cached.Sources, sources) != 0)
+            continue;
+
+        cached.ReferencesCount++;
+        return cached.Module;
+    }
+
+    s_Shaders.Add({stage, sources, CreateShader(stage, sources), 1});
+    return s_Shaders.Last().Module;
+}
+
+void ShaderCache::Release(const Shader *shader){
+    if(!shader)
+        return;
+
+    std::lock_guard<std::mutex> lock(s_ShadersLock);
+
+    for(size_t i = 0; i<s_Shaders.Size(); i++){
+        CachedShader &cached = s_Shaders[i];
+
+        if(cached.Module != shader)
+            continue;
+
+        if(!--cached.ReferencesCount){
+            delete cached.Module;
+            s_Shaders.RemoveAt(i);
+        }
+        return;
+    }
+
+    SX_CORE_ASSERT(false, "ShaderCache: Release of a shader that was not acquired");
+}
+
+bool ShaderCache::LoadPipelineCache(const char *path){
+    if(!s_Hooks.ImportPipelineCache)
+        return false;
+
+    std::FILE *file = std::fopen(path, "rb");
+    if(!file)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    UniquePtr<u8[]> data(size > 0 ? new u8[size] : nullptr);
+    // a partially read blob is worse than none, backend would reject it anyway
+    const bool is_read = size > 0 && std::fread(data.Get(), 1, size, file) == (size_t)size;
+
+    std::fclose(file);
+
+    if(!is_read)
+        return false;
+
+    s_Hooks.ImportPipelineCache({data.Get(), (size_t)size});
+    return true;
+}
+
+bool ShaderCache::SavePipelineCache(const char *path){
+    if(!s_Hooks.ExportPipelineCache)
+        return false;
+
+    List<u8> data = s_Hooks.ExportPipelineCache();
+
+    std::FILE *file = std::fopen(path, "wb");
+    if(!file)
+        return false;
+
+    const bool is_written = std::fwrite(data.Data(), 1, data.Size(), file) == data.Size();
+
+    return std::fclose(file) == 0 && is_written;
+}
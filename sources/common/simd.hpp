@@ -0,0 +1,40 @@
+#ifndef STRAITX_2D_COMMON_SIMD_HPP
+#define STRAITX_2D_COMMON_SIMD_HPP
+
+#include "core/types.hpp"
+#include "graphics/color.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SX_2D_SIMD_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define SX_2D_SIMD_SSE2 0
+#endif
+
+// Does the same as Color::RGBA8 for a whole range of colors
+inline void PackColorsRGBA8(const Color *colors, u32 *packed, size_t count){
+    size_t i = 0;
+#if SX_2D_SIMD_SSE2
+    static_assert(sizeof(Color) == sizeof(float) * 4, "SIMD: Color is expected to be four packed floats");
+
+    const __m128 scale = _mm_set1_ps(255.f);
+
+    for(; i + 4 <= count; i += 4){
+        const float *components = (const float *)(colors + i);
+
+        __m128i c0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(components +  0), scale));
+        __m128i c1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(components +  4), scale));
+        __m128i c2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(components +  8), scale));
+        __m128i c3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(components + 12), scale));
+
+        __m128i c01 = _mm_packs_epi32(c0, c1);
+        __m128i c23 = _mm_packs_epi32(c2, c3);
+
+        _mm_storeu_si128((__m128i*)(packed + i), _mm_packus_epi16(c01, c23));
+    }
+#endif
+    for(; i < count; i++)
+        packed[i] = colors[i].RGBA8();
+}
+
+#endif//STRAITX_2D_COMMON_SIMD_HPP
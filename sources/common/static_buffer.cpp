@@ -0,0 +1,29 @@
+#include "2d/common/static_buffer.hpp"
+#include "core/os/memory.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/fence.hpp"
+#include "graphics/api/gpu.hpp"
+
+Buffer *CreateStaticBuffer(const void *data, size_t size, BufferUsage usage){
+    Buffer *staging = Buffer::Create(size, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+    Memory::Copy(data, staging->Map<u8>(), size);
+
+    Buffer *buffer = Buffer::Create(size, BufferMemoryType::VRAM, usage | BufferUsageBits::TransferDestination);
+
+    CommandPool *pool = CommandPool::Create();
+    CommandBuffer *cmd_buffer = pool->Alloc();
+
+    cmd_buffer->Begin();
+    cmd_buffer->Copy(staging, buffer, size);
+    cmd_buffer->End();
+
+    Fence fence;
+    GPU::Execute(cmd_buffer, fence);
+    fence.WaitFor();
+
+    pool->Free(cmd_buffer);
+    delete pool;
+    delete staging;
+
+    return buffer;
+}
@@ -0,0 +1,291 @@
+#include "2d/draw_capture.hpp"
+#include "2d/rect_renderer.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "core/os/memory.hpp"
+#include "graphics/api/texture.hpp"
+
+namespace {
+
+struct FileHeader{
+    u32 Magic;
+    u32 Version;
+};
+
+struct CommandHeader{
+    u32 Type;
+    u32 PayloadSize;
+};
+
+struct BoundaryPayload{
+    Vector2u FramebufferSize;
+    ViewportParameters Viewport;
+};
+
+struct RectPayload{
+    Vector2f Position;
+    Vector2f Size;
+    Vector2f Origin;
+    float    Angle;
+    u32      PackedColor;
+    u32      Texture;
+    Vector2f TexCoordsMin;
+    Vector2f TexCoordsMax;
+};
+
+// followed by positions, sizes, optional angles and colors
+struct RectsPayload{
+    u32 Count;
+    u32 Texture;
+    u32 HasAngles;
+};
+
+struct CirclePayload{
+    Vector2s Center;
+    float    Radius;
+    Color    CircleColor;
+};
+
+// followed by centers, radii and colors
+struct CirclesPayload{
+    u32 Count;
+};
+
+// followed by points
+struct LinesPayload{
+    u32   Count;
+    u32   Width;
+    Color LineColor;
+};
+
+static_assert(sizeof(Color) % 4 == 0 && sizeof(Vector2s) == 8 && sizeof(Vector2f) == 8, "DrawCapture: every field should be 4 bytes aligned");
+
+template<typename Type>
+Type ReadPayload(const DrawCaptureCommand &command){
+    Type value;
+    Memory::Copy(command.Payload, &value, sizeof(value));
+    return value;
+}
+
+Texture2D *ResolveTexture(const DrawCaptureTargets &targets, u32 id){
+    if(!id || !targets.Textures.Size())
+        return Texture2D::White();
+    return targets.Textures[(id - 1) % targets.Textures.Size()];
+}
+
+}//namespace
+
+DrawCapture::DrawCapture(const char *path):
+    m_File(std::fopen(path, "wb"))
+{
+    m_TextureIds.emplace(Texture2D::White(), 0);
+
+    Write(FileHeader{Magic, Version});
+}
+
+DrawCapture::~DrawCapture(){
+    if(m_File)
+        std::fclose(m_File);
+}
+
+void DrawCapture::Boundary(DrawCommandType type, Vector2u framebuffer_size, const ViewportParameters &viewport){
+    BeginCommand(type, sizeof(BoundaryPayload));
+    Write(BoundaryPayload{framebuffer_size, viewport});
+
+    Flush();
+}
+
+void DrawCapture::Boundary(DrawCommandType type){
+    BeginCommand(type, 0);
+
+    Flush();
+}
+
+void DrawCapture::Rect(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, const Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max){
+    BeginCommand(DrawCommandType::Rect, sizeof(RectPayload));
+    Write(RectPayload{position, size, origin, angle, color, TextureId(texture), tex_coords_min, tex_coords_max});
+}
+
+void DrawCapture::Rects(ConstSpan<Vector2f> positions, ConstSpan<Vector2f> sizes, ConstSpan<float> angles, ConstSpan<Color> colors, const Texture2D *texture){
+    const size_t count = positions.Size();
+
+    BeginCommand(DrawCommandType::Rects, sizeof(RectsPayload) + count * (sizeof(Vector2f) * 2 + sizeof(Color)) + angles.Size() * sizeof(float));
+    Write(RectsPayload{(u32)count, TextureId(texture), angles.Size() != 0});
+    Write(positions.Pointer(), count * sizeof(Vector2f));
+    Write(sizes.Pointer(), count * sizeof(Vector2f));
+    Write(angles.Pointer(), angles.Size() * sizeof(float));
+    Write(colors.Pointer(), count * sizeof(Color));
+}
+
+void DrawCapture::Circle(Vector2s center, float radius, Color color){
+    BeginCommand(DrawCommandType::Circle, sizeof(CirclePayload));
+    Write(CirclePayload{center, radius, color});
+}
+
+void DrawCapture::Circles(ConstSpan<Vector2f> centers, ConstSpan<float> radii, ConstSpan<Color> colors){
+    const size_t count = centers.Size();
+
+    BeginCommand(DrawCommandType::Circles, sizeof(CirclesPayload) + count * (sizeof(Vector2f) + sizeof(float) + sizeof(Color)));
+    Write(CirclesPayload{(u32)count});
+    Write(centers.Pointer(), count * sizeof(Vector2f));
+    Write(radii.Pointer(), count * sizeof(float));
+    Write(colors.Pointer(), count * sizeof(Color));
+}
+
+void DrawCapture::Lines(ConstSpan<Vector2s> points, Color color, u32 width){
+    BeginCommand(DrawCommandType::Lines, sizeof(LinesPayload) + points.Size() * sizeof(Vector2s));
+    Write(LinesPayload{(u32)points.Size(), width, color});
+    Write(points.Pointer(), points.Size() * sizeof(Vector2s));
+}
+
+void DrawCapture::Flush(){
+    if(m_File)
+        std::fflush(m_File);
+}
+
+void DrawCapture::BeginCommand(DrawCommandType type, size_t payload_size){
+    Write(CommandHeader{(u32)type, (u32)payload_size});
+}
+
+void DrawCapture::Write(const void *data, size_t size){
+    if(m_File && size)
+        std::fwrite(data, 1, size, m_File);
+}
+
+u32 DrawCapture::TextureId(const Texture2D *texture){
+    auto it = m_TextureIds.find(texture);
+    if(it != m_TextureIds.end())
+        return it->second;
+
+    u32 id = (u32)m_TextureIds.size();
+    m_TextureIds.emplace(texture, id);
+    return id;
+}
+
+DrawCaptureReader::DrawCaptureReader(const void *data, size_t size):
+    m_Data((const u8 *)data),
+    m_Size(size)
+{
+    FileHeader header;
+    if(m_Size < sizeof(header))
+        return;
+
+    Memory::Copy(m_Data, &header, sizeof(header));
+    m_IsValid = header.Magic == DrawCapture::Magic && header.Version == DrawCapture::Version;
+
+    Rewind();
+}
+
+bool DrawCaptureReader::Next(DrawCaptureCommand &command){
+    if(!m_IsValid || m_Offset + sizeof(CommandHeader) > m_Size)
+        return false;
+
+    CommandHeader header;
+    Memory::Copy(m_Data + m_Offset, &header, sizeof(header));
+
+    if(m_Offset + sizeof(header) + header.PayloadSize > m_Size)
+        return false;
+
+    command.Type = (DrawCommandType)header.Type;
+    command.Payload = m_Data + m_Offset + sizeof(header);
+    command.PayloadSize = header.PayloadSize;
+
+    const bool is_boundary = command.Type == DrawCommandType::RectRender
+                          || command.Type == DrawCommandType::CirclesBegin
+                          || command.Type == DrawCommandType::LinesBegin;
+
+    if(is_boundary && command.PayloadSize >= sizeof(BoundaryPayload))
+        command.FramebufferSize = ReadPayload<BoundaryPayload>(command).FramebufferSize;
+
+    m_Offset += sizeof(header) + header.PayloadSize;
+    return true;
+}
+
+void DrawCaptureReader::Rewind(){
+    m_Offset = sizeof(FileHeader);
+}
+
+void DrawCaptureReader::Replay(const DrawCaptureCommand &command, const DrawCaptureTargets &targets){
+    // payloads shorter than their command needs come from a corrupted file and are skipped
+    auto fits = [&](size_t size){
+        return size <= command.PayloadSize;
+    };
+
+    switch(command.Type){
+    case DrawCommandType::RectRender:
+        if(targets.Rects && fits(sizeof(BoundaryPayload)))
+            targets.Rects->CmdRender(targets.CmdBuffer, targets.Target, ReadPayload<BoundaryPayload>(command).Viewport);
+        break;
+    case DrawCommandType::CirclesBegin:
+        if(targets.Circles && fits(sizeof(BoundaryPayload)))
+            targets.Circles->BeginDrawing(targets.WaitSemaphore, targets.Target, ReadPayload<BoundaryPayload>(command).Viewport);
+        break;
+    case DrawCommandType::LinesBegin:
+        if(targets.Lines && fits(sizeof(BoundaryPayload)))
+            targets.Lines->BeginDrawing(targets.WaitSemaphore, targets.Target, ReadPayload<BoundaryPayload>(command).Viewport);
+        break;
+    case DrawCommandType::CirclesEnd:
+        if(targets.Circles)
+            targets.Circles->EndDrawing(targets.SignalSemaphore);
+        break;
+    case DrawCommandType::LinesEnd:
+        if(targets.Lines)
+            targets.Lines->EndDrawing(targets.SignalSemaphore);
+        break;
+    case DrawCommandType::Rect:
+        if(targets.Rects && fits(sizeof(RectPayload))){
+            const RectPayload rect = ReadPayload<RectPayload>(command);
+            targets.Rects->PushRect(rect.Position, rect.Size, rect.Origin, rect.Angle, rect.PackedColor, ResolveTexture(targets, rect.Texture), rect.TexCoordsMin, rect.TexCoordsMax);
+        }
+        break;
+    case DrawCommandType::Rects:
+        if(targets.Rects && fits(sizeof(RectsPayload))){
+            const RectsPayload rects = ReadPayload<RectsPayload>(command);
+            const size_t count = rects.Count;
+            const size_t angles_count = rects.HasAngles ? count : 0;
+
+            if(!fits(sizeof(RectsPayload) + count * (sizeof(Vector2f) * 2 + sizeof(Color)) + angles_count * sizeof(float)))
+                break;
+
+            const u8 *data = command.Payload + sizeof(RectsPayload);
+            const Vector2f *positions = (const Vector2f *)data;
+            const Vector2f *sizes     = positions + count;
+            const float    *angles    = (const float *)(sizes + count);
+            const Color    *colors    = (const Color *)(angles + angles_count);
+
+            targets.Rects->DrawRects({positions, count}, {sizes, count}, {angles, angles_count}, {colors, count}, ResolveTexture(targets, rects.Texture));
+        }
+        break;
+    case DrawCommandType::Circle:
+        if(targets.Circles && fits(sizeof(CirclePayload))){
+            const CirclePayload circle = ReadPayload<CirclePayload>(command);
+            targets.Circles->DrawCircle(circle.Center, circle.Radius, circle.CircleColor);
+        }
+        break;
+    case DrawCommandType::Circles:
+        if(targets.Circles && fits(sizeof(CirclesPayload))){
+            const size_t count = ReadPayload<CirclesPayload>(command).Count;
+
+            if(!fits(sizeof(CirclesPayload) + count * (sizeof(Vector2f) + sizeof(float) + sizeof(Color))))
+                break;
+
+            const Vector2f *centers = (const Vector2f *)(command.Payload + sizeof(CirclesPayload));
+            const float    *radii   = (const float *)(centers + count);
+            const Color    *colors  = (const Color *)(radii + count);
+
+            targets.Circles->DrawCircles({centers, count}, {radii, count}, {colors, count});
+        }
+        break;
+    case DrawCommandType::Lines:
+        if(targets.Lines && fits(sizeof(LinesPayload))){
+            const LinesPayload lines = ReadPayload<LinesPayload>(command);
+
+            if(!fits(sizeof(LinesPayload) + lines.Count * sizeof(Vector2s)))
+                break;
+
+            const Vector2s *points = (const Vector2s *)(command.Payload + sizeof(LinesPayload));
+            targets.Lines->DrawLines({points, lines.Count}, lines.LineColor, lines.Width);
+        }
+        break;
+    }
+}
@@ -0,0 +1,405 @@
+#include "2d/draw_queue.hpp"
+#include "2d/common/shader_cache.hpp"
+#include "2d/common/quad_index_buffer.hpp"
+#include "common/radix_sort.hpp"
+#include "core/string.hpp"
+#include "core/assert.hpp"
+#include "core/ranges/algorithm.hpp"
+#include "core/math/functions.hpp"
+#include "graphics/api/command_buffer.hpp"
+#include "graphics/api/render_pass.hpp"
+
+static const char *s_RectVertexShader =
+#if SX_2D_COMPACT_INSTANCES
+    #include "shaders/rect_renderer_compact.vert.glsl"
+#else
+    #include "shaders/rect_renderer.vert.glsl"
+#endif
+;
+
+static const char *s_RectFragmentShader =
+    #include "shaders/rect_renderer.frag.glsl"
+;
+
+static const char *s_CircleVertexShader =
+    #include "shaders/circle_renderer.vert.glsl"
+;
+
+static const char *s_CircleFragmentShader =
+    #include "shaders/circle_renderer.frag.glsl"
+;
+
+static const char *s_LineVertexShader =
+    #include "shaders/line_renderer.vert.glsl"
+;
+
+static const char *s_LineFragmentShader =
+    #include "shaders/line_renderer.frag.glsl"
+;
+
+static Array<VertexAttribute, 2> s_LineVertexAttributes = {
+        VertexAttribute::Float32x2,
+        VertexAttribute::UNorm8x4
+};
+
+DrawQueue::UploadBuffer::~UploadBuffer(){
+    delete Staging;
+    delete Device;
+}
+
+void *DrawQueue::UploadBuffer::Reserve(size_t size, BufferUsage usage){
+    if(!size || (Staging && Staging->Size() >= size))
+        return Data;
+
+    delete Staging;
+    delete Device;
+
+    Staging = Buffer::Create(size, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+    Device  = Buffer::Create(size, BufferMemoryType::VRAM, usage | BufferUsageBits::TransferDestination);
+    Data = Staging->Map<u8>();
+
+    return Data;
+}
+
+DrawQueue::Frame::~Frame(){
+    for(UploadBuffer *chunk: RectChunks)
+        delete chunk;
+}
+
+DrawQueue::DrawQueue(const RenderPass *rp, size_t frames_in_flight):
+    m_RectSetLayout(
+        DescriptorSetLayout::Create({
+            ShaderBinding(0, 1,                  ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
+            ShaderBinding(1, MaxTexturesInBatch, ShaderBindingType::Texture,       ShaderStageBits::Fragment),
+            ShaderBinding(2, 1,                  ShaderBindingType::StorageBuffer, ShaderStageBits::Vertex)
+        })
+    ),
+    m_CircleSetLayout(
+        DescriptorSetLayout::Create({
+            ShaderBinding(0, 1, ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
+            ShaderBinding(1, 1, ShaderBindingType::StorageBuffer, ShaderStageBits::Vertex)
+        })
+    ),
+    m_LineSetLayout(
+        DescriptorSetLayout::Create({
+            ShaderBinding(0, 1, ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex)
+        })
+    ),
+    m_Frames(new Frame[frames_in_flight]),
+    m_FramesCount(frames_in_flight)
+{
+    SX_CORE_ASSERT(frames_in_flight, "DrawQueue: at least one frame in flight is required");
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        Frame &frame = m_Frames[i];
+        frame.RectSetPool   = new SingleFrameDescriptorSetPool({MaxSets, m_RectSetLayout.Get()},   PreallocatedSets);
+        frame.CircleSetPool = new SingleFrameDescriptorSetPool({MaxSets, m_CircleSetLayout.Get()}, PreallocatedSets);
+        frame.LineSetPool   = new SingleFrameDescriptorSetPool({MaxSets, m_LineSetLayout.Get()},   PreallocatedSets);
+    }
+
+    m_FramebufferPass = rp;
+    m_IndexBuffer = QuadIndexBuffer::Acquire();
+
+    m_Shaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_RectVertexShader);
+    m_Shaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_RectFragmentShader);
+    m_Shaders[2] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_CircleVertexShader);
+    m_Shaders[3] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_CircleFragmentShader);
+    m_Shaders[4] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_LineVertexShader);
+    m_Shaders[5] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_LineFragmentShader);
+
+    {
+        GraphicsPipelineProperties props;
+        props.Shaders = {&m_Shaders[0], 2};
+        props.Pass = m_FramebufferPass;
+        props.Layout = m_RectSetLayout.Get();
+
+        m_RectPipeline = GraphicsPipeline::Create(props);
+    }
+
+    {
+        GraphicsPipelineProperties props;
+        props.Shaders = {&m_Shaders[2], 2};
+        props.Pass = m_FramebufferPass;
+        props.Layout = m_CircleSetLayout.Get();
+
+        m_CirclePipeline = GraphicsPipeline::Create(props);
+    }
+
+    {
+        GraphicsPipelineProperties props;
+        props.PrimitivesTopology = PrimitivesTopology::LinesStrip;
+        props.PrimitiveRestartEnable = true;
+        props.Shaders = {&m_Shaders[4], 2};
+        props.VertexAttributes = s_LineVertexAttributes;
+        props.Pass = m_FramebufferPass;
+        props.Layout = m_LineSetLayout.Get();
+
+        m_LinePipeline = GraphicsPipeline::Create(props);
+    }
+}
+
+DrawQueue::~DrawQueue(){
+    // pipelines should go before shaders they were created from
+    m_RectPipeline   = nullptr;
+    m_CirclePipeline = nullptr;
+    m_LinePipeline   = nullptr;
+
+    for(auto shader: m_Shaders)
+        ShaderCache::Release(shader);
+
+    QuadIndexBuffer::Release();
+}
+
+void DrawQueue::DrawRect(Layer layer, Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max){
+    // sort is stable, so rects of a layer stay in submission order and BuildRuns packs their textures
+    PushCommand(layer, PrimitiveType::Rect, 0, m_Rects.Size());
+
+    m_Rects.Add(RectInstance::Make(position, size, origin, angle, color.RGBA8(), tex_coords_min, tex_coords_max, 0));
+    m_RectTextures.Add(texture);
+}
+
+void DrawQueue::DrawCircle(Layer layer, Vector2f center, float radius, Color color){
+    PushCommand(layer, PrimitiveType::Circle, 0, m_Circles.Size());
+
+    m_Circles.Add({center, radius, color.RGBA8()});
+}
+
+void DrawQueue::DrawLines(Layer layer, ConstSpan<Vector2s> points, Color color, u32 width){
+    PushCommand(layer, PrimitiveType::Line, Math::Min(width, MaxSubkey), m_Polylines.Size());
+
+    m_Polylines.Add({m_LinePoints.Size(), points.Size(), width});
+
+    const u32 packed_color = color.RGBA8();
+    for(const Vector2s &point: points)
+        m_LinePoints.Add({Vector2f(point), packed_color});
+}
+
+void DrawQueue::PushCommand(Layer layer, PrimitiveType type, u32 subkey, size_t index){
+    SX_CORE_ASSERT(index <= 0xFFFFFFFF, "DrawQueue: Too many primitives of the same type");
+
+    const u64 key = ((u64)layer << 16) | ((u64)type << SubkeyBits) | subkey;
+
+    m_Commands.Add((key << 32) | index);
+}
+
+void DrawQueue::BuildRuns(RectInstance *const *rect_chunks, CircleInstance *circles, LineVertex *line_vertices, u32 *line_indices){
+    size_t rects_count = 0;
+    size_t circles_count = 0;
+    size_t vertices_count = 0;
+    size_t indices_count = 0;
+
+    for(u64 command: m_Commands){
+        const PrimitiveType type = (PrimitiveType)((command >> (32 + SubkeyBits)) & 0x3);
+        const size_t index = (u32)command;
+
+        Run *run = m_Runs.Size() && m_Runs.Last().Type == type ? &m_Runs.Last() : nullptr;
+
+        switch(type){
+        case PrimitiveType::Rect:{
+            const Texture2D *texture = m_RectTextures[index];
+            const size_t chunk = rects_count / QuadIndexBuffer::MaxQuadsCount;
+            const size_t chunk_index = rects_count % QuadIndexBuffer::MaxQuadsCount;
+
+            size_t texture_index = run && run->Chunk == chunk ? run->Textures | IndexOf(texture) : -1;
+
+            if(!run || run->Chunk != chunk || (texture_index == -1 && run->Textures.Size() == run->Textures.Capacity())){
+                Run rect_run;
+                rect_run.Type  = type;
+                rect_run.Chunk = chunk;
+                rect_run.First = chunk_index;
+                m_Runs.Add(rect_run);
+                run = &m_Runs.Last();
+            }
+
+            if(texture_index == -1){
+                texture_index = run->Textures.Size();
+                run->Textures.Add(texture);
+            }
+
+            RectInstance &instance = rect_chunks[chunk][chunk_index];
+            instance = m_Rects[index];
+            instance.SetTexIndex((u32)texture_index);
+
+            rects_count++;
+        }break;
+        case PrimitiveType::Circle:{
+            if(!run){
+                Run circle_run;
+                circle_run.Type  = type;
+                circle_run.First = circles_count;
+                m_Runs.Add(circle_run);
+                run = &m_Runs.Last();
+            }
+
+            circles[circles_count++] = m_Circles[index];
+        }break;
+        case PrimitiveType::Line:{
+            const Polyline &polyline = m_Polylines[index];
+
+            if(!run || run->LineWidth != polyline.Width){
+                Run line_run;
+                line_run.Type  = type;
+                line_run.First = indices_count;
+                line_run.LineWidth = polyline.Width;
+                m_Runs.Add(line_run);
+                run = &m_Runs.Last();
+            }
+
+            for(size_t i = 0; i<polyline.PointsCount; i++){
+                line_vertices[vertices_count] = m_LinePoints[polyline.FirstPoint + i];
+                line_indices[indices_count++] = (u32)vertices_count++;
+            }
+            line_indices[indices_count++] = 0xFFFFFFFF;
+
+            // line runs count indices, everything else counts primitives
+            run->Count += polyline.PointsCount;
+        }break;
+        }
+
+        run->Count++;
+    }
+}
+
+void DrawQueue::CmdRender(CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    frame.RectSetPool->NextFrame();
+    frame.CircleSetPool->NextFrame();
+    frame.LineSetPool->NextFrame();
+
+    if(m_SortScratchCapacity < m_Commands.Size()){
+        m_SortScratchCapacity = m_Commands.Size();
+        m_SortScratch = new u64[m_SortScratchCapacity];
+    }
+
+    RadixSortByKey(m_Commands.Data(), m_SortScratch.Get(), m_Commands.Size());
+
+    const size_t indices_count = m_LinePoints.Size() + m_Polylines.Size();
+
+    const size_t max_chunk_rects = QuadIndexBuffer::MaxQuadsCount;
+    const size_t rect_chunks_count = (m_Rects.Size() + max_chunk_rects - 1) / max_chunk_rects;
+
+    while(frame.RectChunks.Size() < rect_chunks_count)
+        frame.RectChunks.Add(new UploadBuffer());
+
+    m_RectChunksData.Clear();
+    for(size_t i = 0; i<rect_chunks_count; i++){
+        const size_t chunk_rects = Math::Min(m_Rects.Size() - i * max_chunk_rects, max_chunk_rects);
+
+        m_RectChunksData.Add((RectInstance *)frame.RectChunks[i]->Reserve(chunk_rects * sizeof(RectInstance), BufferUsageBits::StorageBuffer));
+    }
+
+    BuildRuns(
+        m_RectChunksData.Data(),
+        (CircleInstance *)frame.Circles.Reserve(m_Circles.Size() * sizeof(CircleInstance), BufferUsageBits::StorageBuffer),
+        (LineVertex *)frame.LineVertices.Reserve(m_LinePoints.Size() * sizeof(LineVertex), BufferUsageBits::VertexBuffer),
+        (u32 *)frame.LineIndices.Reserve(indices_count * sizeof(u32), BufferUsageBits::IndexBuffer)
+    );
+
+    const Vector2f fb_size = Vector2f(fb->Size());
+
+    // rects keep RectRenderer's space, circles and lines are transformed the way static geometry of their renderers is
+    RectUniform rect_uniform;
+    rect_uniform.u_Projection[0][0] = 2.f / viewport.ViewportSize.x;
+    rect_uniform.u_Projection[1][1] = 2.f / viewport.ViewportSize.y;
+
+    const ViewUniform view_uniform = ViewUniform::Make(fb->Size(), viewport);
+
+    cmd_buffer->Copy(rect_uniform, m_RectUniformBuffer);
+    cmd_buffer->Copy(view_uniform, m_ViewUniformBuffer);
+
+    for(size_t i = 0; i<rect_chunks_count; i++){
+        const size_t chunk_rects = Math::Min(m_Rects.Size() - i * max_chunk_rects, max_chunk_rects);
+
+        cmd_buffer->Copy(frame.RectChunks[i]->Staging, frame.RectChunks[i]->Device, chunk_rects * sizeof(RectInstance));
+    }
+    if(m_Circles.Size())
+        cmd_buffer->Copy(frame.Circles.Staging, frame.Circles.Device, m_Circles.Size() * sizeof(CircleInstance));
+    if(indices_count){
+        cmd_buffer->Copy(frame.LineVertices.Staging, frame.LineVertices.Device, m_LinePoints.Size() * sizeof(LineVertex));
+        cmd_buffer->Copy(frame.LineIndices.Staging, frame.LineIndices.Device, indices_count * sizeof(u32));
+    }
+
+    DescriptorSet *circle_set = nullptr;
+    if(m_Circles.Size()){
+        circle_set = frame.CircleSetPool->Alloc();
+        circle_set->UpdateUniformBinding(0, 0, m_ViewUniformBuffer);
+        circle_set->UpdateStorageBufferBinding(1, 0, frame.Circles.Device);
+    }
+
+    DescriptorSet *line_set = nullptr;
+    if(indices_count){
+        line_set = frame.LineSetPool->Alloc();
+        line_set->UpdateUniformBinding(0, 0, m_ViewUniformBuffer);
+    }
+
+    const GraphicsPipeline *bound_pipeline = nullptr;
+
+    cmd_buffer->BeginRenderPass(m_FramebufferPass, fb);
+    for(const Run &run: m_Runs){
+        switch(run.Type){
+        case PrimitiveType::Rect:{
+            if(bound_pipeline != m_RectPipeline.Get()){
+                bound_pipeline = m_RectPipeline.Get();
+
+                cmd_buffer->Bind(m_RectPipeline.Get());
+                cmd_buffer->SetScissor (0, 0, fb_size.x, fb_size.y);
+                cmd_buffer->SetViewport(0, 0, fb_size.x, fb_size.y);
+                cmd_buffer->BindIndexBuffer(m_IndexBuffer, IndicesType::Uint32);
+            }
+
+            DescriptorSet *set = frame.RectSetPool->Alloc();
+            set->UpdateUniformBinding(0, 0, m_RectUniformBuffer);
+            set->UpdateStorageBufferBinding(2, 0, frame.RectChunks[run.Chunk]->Device);
+
+            for(size_t i = 0; i < run.Textures.Size(); i++)
+                set->UpdateTextureBinding(1, i, run.Textures[i], m_DefaultSampler.Get());
+
+            cmd_buffer->Bind(set);
+            cmd_buffer->DrawIndexed(run.Count * 6, run.First * 6);
+        }break;
+        case PrimitiveType::Circle:{
+            if(bound_pipeline != m_CirclePipeline.Get()){
+                bound_pipeline = m_CirclePipeline.Get();
+
+                cmd_buffer->Bind(m_CirclePipeline.Get());
+                cmd_buffer->SetScissor (viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+                cmd_buffer->SetViewport(viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+                cmd_buffer->Bind(circle_set);
+            }
+
+            cmd_buffer->Draw(run.Count * 6, run.First * 6);
+        }break;
+        case PrimitiveType::Line:{
+            if(bound_pipeline != m_LinePipeline.Get()){
+                bound_pipeline = m_LinePipeline.Get();
+
+                cmd_buffer->Bind(m_LinePipeline.Get());
+                cmd_buffer->SetScissor (viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+                cmd_buffer->SetViewport(viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+                cmd_buffer->Bind(line_set);
+                cmd_buffer->BindVertexBuffer(frame.LineVertices.Device);
+                cmd_buffer->BindIndexBuffer(frame.LineIndices.Device, IndicesType::Uint32);
+            }
+
+            cmd_buffer->SetLineWidth(run.LineWidth);
+            cmd_buffer->DrawIndexed(run.Count, run.First);
+        }break;
+        }
+    }
+    cmd_buffer->EndRenderPass();
+
+    Clear();
+
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+}
+
+void DrawQueue::Clear(){
+    m_Rects.Clear();
+    m_RectTextures.Clear();
+    m_Circles.Clear();
+    m_LinePoints.Clear();
+    m_Polylines.Clear();
+    m_Commands.Clear();
+    m_Runs.Clear();
+}
@@ -0,0 +1,46 @@
+#include "2d/draw_recorder.hpp"
+#include "core/ranges/algorithm.hpp"
+
+void DrawRecorder::DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, const Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max){
+    if(!m_RectRanges.Size())
+        m_RectRanges.Add({});
+
+    size_t texture_index = m_RectRanges.Last().Textures | IndexOf(texture);
+
+    if(texture_index == -1){
+        if(m_RectRanges.Last().Textures.Size() == MaxTexturesInRange){
+            m_RectRanges.Add({});
+            m_RectRanges.Last().FirstInstance = m_Rects.Size();
+        }
+
+        texture_index = m_RectRanges.Last().Textures.Size();
+        m_RectRanges.Last().Textures.Add(texture);
+    }
+
+    // instances are built here, on the producer thread, so merge is a plain copy
+    m_Rects.Add(RectInstance::Make(position, size, origin, angle, color.RGBA8(), tex_coords_min, tex_coords_max, (u32)texture_index));
+    m_RectRanges.Last().InstancesCount++;
+}
+
+void DrawRecorder::DrawCircle(Vector2s center, float radius, Color color){
+    m_Circles.Add({Vector2f(center), radius, color.RGBA8()});
+}
+
+void DrawRecorder::DrawLines(ConstSpan<Vector2s> points, Color color, u32 width){
+    m_Polylines.Add({m_LineVertices.Size(), points.Size(), width});
+
+    const u32 packed_color = color.RGBA8();
+
+    for(const Vector2s &point: points)
+        m_LineVertices.Add({Vector2f(point), packed_color});
+}
+
+void DrawRecorder::Clear(){
+    m_Rects.Clear();
+    m_RectRanges.Clear();
+
+    m_Circles.Clear();
+
+    m_LineVertices.Clear();
+    m_Polylines.Clear();
+}
@@ -1,5 +1,17 @@
 #include "2d/line_renderer.hpp"
+#include "2d/draw_capture.hpp"
+#include "2d/draw_recorder.hpp"
+#include "2d/renderer_2d.hpp"
+#include "2d/common/shader_cache.hpp"
+#include "2d/common/static_buffer.hpp"
+#include "2d/common/quad_index_buffer.hpp"
+#include "common/packing.hpp"
+#include "common/decimation.hpp"
+#include <cmath>
 #include "core/string.hpp"
+#include "core/assert.hpp"
+#include "core/os/memory.hpp"
+#include "core/math/functions.hpp"
 #include "graphics/api/command_buffer.hpp"
 #include "graphics/api/gpu.hpp"
 #include "graphics/api/render_pass.hpp"
@@ -14,46 +26,199 @@ static const char *s_FragmentShader =
     #include "shaders/line_renderer.frag.glsl"
 ;
 
+static const char *s_ExpandedVertexShader = 
+    #include "shaders/line_renderer_expanded.vert.glsl"
+;
+
+static const char *s_ExpandedFragmentShader = 
+    #include "shaders/line_renderer_expanded.frag.glsl"
+;
+
 static Array<ShaderBinding, 1> s_ShaderBindings = {
         ShaderBinding(0, 1,                              ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex)
 };
 
+static Array<ShaderBinding, 2> s_ExpandedShaderBindings = {
+        ShaderBinding(0, 1,                              ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
+        ShaderBinding(1, 1,                              ShaderBindingType::StorageBuffer, ShaderStageBits::Vertex)
+};
+
+static u32 PackDirection(Vector2f from, Vector2f to){
+    Vector2f direction = to - from;
+    float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+
+    return length > 0.f ? PackSnorm2x16(direction.x / length, direction.y / length) : 0;
+}
+
+// segment between points i - 1 and i. Neighbours come from the polyline even when they are culled
+// or in another batch, so joins stay intact. Everything is in world space, view transform is applied by the shader
+template<typename PointAt>
+static LineRenderer::LineSegment MakeSegment(PointAt point_at, size_t points_count, size_t i, u32 width, LineRenderer::LineJoin join, u32 color){
+    u32 prev_direction = i > 1 ? PackDirection(point_at(i - 2), point_at(i - 1)) : 0;
+    u32 next_direction = i + 1 < points_count ? PackDirection(point_at(i), point_at(i + 1)) : 0;
+
+    const u32 width_and_join = Math::Min(width, 0xFFFFu) | ((u32)join << 16);
+
+    return {point_at(i - 1), point_at(i), prev_direction, next_direction, width_and_join, color};
+}
+
+static_assert(sizeof(LineRenderer::LineSegment) == 32, "LineRenderer: LineSegment should match std430 layout of the expanded vertex shader");
+
 static Array<VertexAttribute, 2> s_VertexAttributes = {
         VertexAttribute::Float32x2,
         VertexAttribute::UNorm8x4
 };
 
-LineRenderer::Batch::Batch(){
-    VerticesBuffer = Buffer::Create(sizeof(LineVertex) * MaxVerticesInBatch, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
-    IndicesBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+LineRenderer::Batch::Batch(LineMode mode){
+    if(mode == LineMode::Expanded){
+        SegmentsBuffer = Buffer::Create(sizeof(LineSegment) * MaxSegmentsInBatch, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+        Segments = SegmentsBuffer->Map<LineSegment>();
 
-    Vertices = VerticesBuffer->Map<LineVertex>();
-    Indices  = IndicesBuffer->Map<u32>();
+        SegmentBuffer = Buffer::Create(sizeof(LineSegment) * MaxSegmentsInBatch, BufferMemoryType::DynamicVRAM, BufferUsageBits::StorageBuffer | BufferUsageBits::TransferDestination);
+    }else{
+        VerticesBuffer = Buffer::Create(sizeof(LineVertex) * MaxVerticesInBatch, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+        IndicesBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+        Vertices = VerticesBuffer->Map<LineVertex>();
+        Indices  = IndicesBuffer->Map<u32>();
+
+        VertexBuffer = Buffer::Create(sizeof(LineVertex) * MaxVerticesInBatch, BufferMemoryType::DynamicVRAM, BufferUsageBits::VertexBuffer | BufferUsageBits::TransferDestination);
+        IndexBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::DynamicVRAM, BufferUsageBits::IndexBuffer  | BufferUsageBits::TransferDestination);
+    }
 }
 
 LineRenderer::Batch::~Batch(){
     delete VerticesBuffer;
     delete IndicesBuffer;
+    delete VertexBuffer;
+    delete IndexBuffer;
+    delete SegmentsBuffer;
+    delete SegmentBuffer;
 }
 
 void LineRenderer::Batch::Reset(){
     SubmitedVerticesCount = 0;
     SubmitedIndicesCount  = 0;
+    SubmitedSegmentsCount = 0;
     LineWidth = InvalidLineWidth;
 }
 
-LineRenderer::LineRenderer(const RenderPass *rp){
+LineRenderer::Frame::~Frame(){
+    for(Batch *batch: Batches)
+        delete batch;
+    for(Buffer *chunk: StreamingChunks)
+        delete chunk;
+}
+
+LineRenderer::StaticGeometry::StaticGeometry(const DrawRecorder &recorder){
+    List<u32> indices;
+
+    // recorded vertices are uploaded as they are, only strip indices are generated
+    for(const DrawRecorder::PolylineRecord &polyline: recorder.Polylines()){
+        if(!m_Ranges.Size() || m_Ranges.Last().LineWidth != polyline.Width)
+            m_Ranges.Add({(u32)indices.Size(), 0, polyline.Width});
+
+        for(size_t i = 0; i<polyline.VerticesCount; i++)
+            indices.Add((u32)(polyline.FirstVertex + i));
+        indices.Add(0xFFFFFFFF);
+
+        m_Ranges.Last().IndicesCount = (u32)indices.Size() - m_Ranges.Last().FirstIndex;
+    }
+
+    if(!indices.Size())
+        return;
+
+    ConstSpan<LineVertex> vertices = recorder.LineVertices();
+
+    m_Vertices = CreateStaticBuffer(vertices.Pointer(), vertices.Size() * sizeof(LineVertex), BufferUsageBits::VertexBuffer);
+    m_Indices  = CreateStaticBuffer(indices.Data(),  indices.Size()  * sizeof(u32),        BufferUsageBits::IndexBuffer);
+}
+
+LineRenderer::StaticGeometry::~StaticGeometry(){
+    delete m_Vertices;
+    delete m_Indices;
+}
+
+LineRenderer::StreamingPolyline::StreamingPolyline(size_t capacity, u32 width):
+    m_Points(new LineVertex[capacity]),
+    m_Capacity(capacity),
+    m_LineWidth(width)
+{
+    SX_CORE_ASSERT(capacity >= 2 && capacity * 2 <= 0xFFFFFFFF, "LineRenderer: StreamingPolyline capacity should fit u32 indices");
+
+    // written only by copies recorded into command buffers
+    m_Vertices = Buffer::Create(sizeof(LineVertex) * m_Capacity, BufferMemoryType::VRAM, BufferUsageBits::VertexBuffer | BufferUsageBits::TransferDestination);
+
+    List<u32> indices;
+    for(size_t i = 0; i<m_Capacity * 2; i++)
+        indices.Add((u32)(i % m_Capacity));
+
+    m_Indices = CreateStaticBuffer(indices.Data(), indices.Size() * sizeof(u32), BufferUsageBits::IndexBuffer);
+}
+
+LineRenderer::StreamingPolyline::~StreamingPolyline(){
+    delete m_Vertices;
+    delete m_Indices;
+}
+
+void LineRenderer::StreamingPolyline::Append(ConstSpan<Vector2s> points, Color color){
+    // only the newest capacity points can be kept anyway
+    const size_t first = points.Size() > m_Capacity ? points.Size() - m_Capacity : 0;
+    const size_t count = points.Size() - first;
+
+    if(m_Size + count > m_Capacity)
+        Retire(m_Size + count - m_Capacity);
+
+    const u32 packed_color = color.RGBA8();
+
+    size_t slot = (m_First + m_Size) % m_Capacity;
+    for(size_t i = first; i<points.Size(); i++){
+        m_Points[slot] = {Vector2f(points[i]), packed_color};
+        slot = slot + 1 == m_Capacity ? 0 : slot + 1;
+    }
+
+    m_Size += count;
+    m_PendingCount = Math::Min(m_PendingCount + count, m_Capacity);
+}
+
+void LineRenderer::StreamingPolyline::Retire(size_t count){
+    count = Math::Min(count, m_Size);
+
+    m_First = (m_First + count) % m_Capacity;
+    m_Size -= count;
+    // retired points are never drawn, so there is no need to upload them
+    m_PendingCount = Math::Min(m_PendingCount, m_Size);
+}
+
+LineRenderer::LineRenderer(const RenderPass *rp, size_t frames_in_flight, LineMode mode):
+    m_Mode(mode),
+    m_Frames(new Frame[frames_in_flight]),
+    m_FramesCount(frames_in_flight)
+{
+    SX_CORE_ASSERT(frames_in_flight, "LineRenderer: at least one frame in flight is required");
+
     m_FramebufferPass = rp;
 
-    m_SetLayout = DescriptorSetLayout::Create(s_ShaderBindings);
+    if(m_Mode == LineMode::Expanded)
+        m_SetLayout = DescriptorSetLayout::Create(s_ExpandedShaderBindings);
+    else
+        m_SetLayout = DescriptorSetLayout::Create(s_ShaderBindings);
 
-    m_SetPool = DescriptorSetPool::Create({1, m_SetLayout});
-    m_Set = m_SetPool->Alloc();
+    if(m_Mode == LineMode::Expanded){
+        m_Shaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_ExpandedVertexShader);
+        m_Shaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_ExpandedFragmentShader);
 
-    m_Shaders[0] = Shader::Create(ShaderStageBits::Vertex,   {s_VertexShader,   String::Length(s_VertexShader)  } );
-    m_Shaders[1] = Shader::Create(ShaderStageBits::Fragment, {s_FragmentShader, String::Length(s_FragmentShader)} );
+        GraphicsPipelineProperties props;
+        props.Shaders = m_Shaders;
+        props.Pass = m_FramebufferPass;
+        props.Layout = m_SetLayout;
+
+        m_Pipeline = GraphicsPipeline::Create(props);
+
+        m_QuadIndexBuffer = QuadIndexBuffer::Acquire();
+    }else{
+        m_Shaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_VertexShader);
+        m_Shaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_FragmentShader);
 
-    {
         GraphicsPipelineProperties props;
         props.PrimitivesTopology = PrimitivesTopology::LinesStrip;
         props.PrimitiveRestartEnable = true;
@@ -65,48 +230,89 @@ LineRenderer::LineRenderer(const RenderPass *rp){
         m_Pipeline = GraphicsPipeline::Create(props);
     }
 
-    m_CmdPool = CommandPool::Create();
-    m_CmdBuffer = m_CmdPool->Alloc();
-
-    m_VertexBuffer = Buffer::Create(sizeof(LineVertex) * MaxVerticesInBatch, BufferMemoryType::DynamicVRAM, BufferUsageBits::VertexBuffer | BufferUsageBits::TransferDestination);
-    m_IndexBuffer  = Buffer::Create(sizeof(u32)        * MaxIndicesInBatch,  BufferMemoryType::DynamicVRAM, BufferUsageBits::IndexBuffer  | BufferUsageBits::TransferDestination);
-    m_MatricesUniformBuffer = Buffer::Create(sizeof(MatricesUniform), BufferMemoryType::DynamicVRAM, BufferUsageBits::UniformBuffer | BufferUsageBits::TransferSource);
-
-    m_Set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
-
-    m_DrawingFence.Signal();
+    for(size_t i = 0; i<m_FramesCount; i++)
+        m_Frames[i].Batches.Add(new Batch(m_Mode));
 }
 
 LineRenderer::~LineRenderer(){
-    m_DrawingFence.WaitFor();
+    if(m_Submissions){
+        for(size_t i = 0; i<m_FramesCount; i++){
+            Submission &submission = m_Submissions[i];
 
-    delete m_VertexBuffer;
-    delete m_IndexBuffer;
-    delete m_MatricesUniformBuffer;
+            submission.DrawingFence.WaitFor();
 
-    m_CmdPool->Free(m_CmdBuffer);
-    delete m_CmdPool;
+            for(ViewportSlot &slot: submission.Viewports){
+                delete slot.MatricesUniformBuffer;
+                m_SetPool->Free(slot.Set);
+            }
+
+            m_CmdPool->Free(submission.CmdBuffer);
+        }
+    }
 
     delete m_Pipeline;
 
     for(auto shader: m_Shaders)
-        delete shader;
+        ShaderCache::Release(shader);
 
-    m_SetPool->Free(m_Set);
-    delete m_SetPool;
+    m_Submissions = nullptr;
+    m_SetPool = nullptr;
     delete m_SetLayout;
+
+    if(m_QuadIndexBuffer)
+        QuadIndexBuffer::Release();
+}
+
+void LineRenderer::CreateSubmissions(){
+    m_CmdPool = CommandPool::Create();
+    m_SetPool = DescriptorSetPool::Create({m_FramesCount * MaxViewports, m_SetLayout});
+    m_Submissions = new Submission[m_FramesCount];
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        Submission &submission = m_Submissions[i];
+
+        submission.CmdBuffer = m_CmdPool->Alloc();
+
+        for(ViewportSlot &slot: submission.Viewports){
+            slot.Set = m_SetPool->Alloc();
+            slot.MatricesUniformBuffer = Buffer::Create(sizeof(ViewUniform), BufferMemoryType::DynamicVRAM, BufferUsageBits::UniformBuffer | BufferUsageBits::TransferSource);
+            slot.Set->UpdateUniformBinding(0, 0, slot.MatricesUniformBuffer);
+
+            // BeginDrawing/EndDrawing frames never go past the first batch
+            if(m_Mode == LineMode::Expanded)
+                slot.Set->UpdateStorageBufferBinding(1, 0, m_Frames[i].Batches[0]->SegmentBuffer);
+        }
+
+        submission.DrawingFence.Signal();
+    }
 }
 
-Result LineRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, const ViewportParameters &viewport){
+Result LineRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Framebuffer *framebuffer, ConstSpan<ViewportParameters> viewports){
+    SX_CORE_ASSERT(viewports.Size() && viewports.Size() <= MaxViewports, "LineRenderer: from 1 to MaxViewports viewports are supported");
+    SX_CORE_ASSERT(!m_Context, "LineRenderer: Renderer attached to Renderer2D is drawn by its EndFrame");
+
+    if(!m_Submissions)
+        CreateSubmissions();
+
     m_Framebuffer = framebuffer;
-    m_CurrentViewport = viewport;
+    m_FramebufferSize = Vector2f(framebuffer->Size());
+
+    // capture format keeps a single viewport per frame, so only the first one is recorded
+    if(m_Capture)
+        m_Capture->Boundary(DrawCommandType::LinesBegin, framebuffer->Size(), viewports[0]);
 
     m_SemaphoreRing.Begin(wait_semaphore);
 
-    m_BatchRing.Current().Reset();
+    CurrentFrame().Staging().Reset();
+    ResetStreamingStaging();
+
+    m_Viewports.Clear();
+    for(size_t i = 0; i<viewports.Size(); i++){
+        m_ViewportUniforms[i] = ViewUniform::Make(framebuffer->Size(), viewports[i]);
+        m_Viewports.Add(viewports[i]);
+    }
 
-    m_MatricesUniform.u_Projection[0][0] = 2.f/framebuffer->Size().x;
-    m_MatricesUniform.u_Projection[1][1] = 2.f/framebuffer->Size().y;
+    m_CullingBounds = CullingBounds::Centered(Vector2f(framebuffer->Size()));
 
     //XXX Check if framebuffer matches RenderPass
     return Result::Success;
@@ -120,74 +326,588 @@ Result LineRenderer::BeginDrawing(const Semaphore *wait_semaphore, const Framebu
 }
 
 void LineRenderer::EndDrawing(const Semaphore *signal_semaphore){
+    SX_CORE_ASSERT(!m_Context, "LineRenderer: Renderer attached to Renderer2D is drawn by its EndFrame");
+
+    MergeRecorders();
+
+    if(m_Capture)
+        m_Capture->Boundary(DrawCommandType::LinesEnd);
+
     Flush(m_SemaphoreRing.Current(), signal_semaphore);
 
     m_SemaphoreRing.End();
+
+    m_LastFrameStats = m_Stats;
+    m_Stats = {};
 }
 
 void LineRenderer::DrawLines(ConstSpan<Vector2s> points, Color color, u32 width){
-    if(m_BatchRing.Current().IsGeometryFull()
-       || m_BatchRing.Current().LineWidth != InvalidLineWidth && m_BatchRing.Current().LineWidth != width){
+    if(m_Capture)
+        m_Capture->Lines(points, color, width);
+
+    if(points.Size() < 2)
+        return;
+
+    // at least 5 points are needed for a column to have something to drop
+    if(m_IsDecimationEnabled && m_Viewports.Size() == 1 && points.Size() > 4){
+        const float offset_x = Vector2f(Vector2u(m_FramebufferSize)/2u).x - m_Viewports[0].Offset.x;
+
+        m_DecimatedPoints.Clear();
+        {
+            SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+            DecimateByColumns(points, offset_x, m_Viewports[0].Scale.x, [&](Vector2s point){
+                m_DecimatedPoints.Add(point);
+            });
+        }
+
+        if(m_DecimatedPoints.Size() < points.Size())
+            points = {m_DecimatedPoints.Data(), m_DecimatedPoints.Size()};
+    }
+
+    if(m_Mode == LineMode::Expanded){
+        DrawSegments(points, color, width);
+        return;
+    }
+
+    // includes flushes of full batches, their fence waits are counted twice then
+    SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+
+    const u32 packed_color = color.RGBA8();
+    const float extent = width / 2.f;
+
+    // acquired at the first visible segment, so fully culled lines don't flush on width change
+    Batch *batch = nullptr;
+
+    // vertices stay in world space, culling moves them on screen of each viewport
+    auto push_vertex = [&](size_t i){
+        batch->Vertices[batch->SubmitedVerticesCount] = {Vector2f(points[i]), packed_color};
+        batch->Indices[batch->SubmitedIndicesCount] = (u32)batch->SubmitedVerticesCount;
+
+        batch->SubmitedVerticesCount++;
+        batch->SubmitedIndicesCount++;
+    };
+
+    m_CullingStats.Submitted += points.Size() - 1;
+
+    // visible segments are emitted as strips, invisible ones break the strip with a restart index.
+    // StripRoom always keeps an index for the restart, so closing a strip never overflows
+    bool is_strip_open = false;
+    for(size_t i = 1; i<points.Size(); i++){
+        if(!IsSegmentVisible(Vector2f(points[i - 1]), Vector2f(points[i]), extent)){
+            m_CullingStats.Culled++;
+
+            if(is_strip_open)
+                batch->Indices[batch->SubmitedIndicesCount++] = 0xFFFFFFFF;
+            is_strip_open = false;
+            continue;
+        }
+
+        if(!batch){
+            batch = &StripBatch(width);
+        }else if(batch->StripRoom() < (is_strip_open ? 1u : 2u)){
+            if(is_strip_open)
+                batch->Indices[batch->SubmitedIndicesCount++] = 0xFFFFFFFF;
+
+            NextBatch();
+            batch = &StripBatch(width);
+            // strip goes on in the new batch from the previous point, so there is no gap
+            is_strip_open = false;
+        }
+
+        if(!is_strip_open)
+            push_vertex(i - 1);
+        push_vertex(i);
+        is_strip_open = true;
+
+        SX_2D_STATS(m_Stats.Primitives++);
+    }
+
+    if(is_strip_open)
+        batch->Indices[batch->SubmitedIndicesCount++] = 0xFFFFFFFF;
+}
+
+void LineRenderer::DrawSegments(ConstSpan<Vector2s> points, Color color, u32 width){
+    const u32 packed_color = color.RGBA8();
+    // sharp joins are miter limited to 4 half widths past the point in expanded shader
+    const float extent = 2.f * width;
+
+    // includes a flush once in MaxSegmentsInBatch segments, its fence wait is counted twice then
+    SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+
+    m_CullingStats.Submitted += points.Size() - 1;
+
+    for(size_t i = 1; i<points.Size(); i++){
+        if(!IsSegmentVisible(Vector2f(points[i - 1]), Vector2f(points[i]), extent)){
+            m_CullingStats.Culled++;
+            continue;
+        }
+
+        if(CurrentFrame().Staging().IsSegmentsFull())
+            NextBatch();
+
+        Batch &batch = CurrentFrame().Staging();
+
+        batch.Segments[batch.SubmitedSegmentsCount++] = MakeSegment([&](size_t j){ return Vector2f(points[j]); }, points.Size(), i, width, m_LineJoin, packed_color);
+
+        SX_2D_STATS(m_Stats.Primitives++);
+    }
+}
+
+void LineRenderer::DrawStatic(const StaticGeometry &geometry){
+    SX_CORE_ASSERT(m_Mode == LineMode::Native, "LineRenderer: Static geometry is supported only in Native mode");
+
+    if(m_Context){
+        RecordPendingLines();
+
+        for(const StaticGeometry::Range &range: geometry.m_Ranges)
+            m_RecordedDraws.Add({geometry.m_Vertices, geometry.m_Indices, range.FirstIndex, range.IndicesCount, range.LineWidth});
+        return;
+    }
+
+    if(CurrentFrame().Staging().SubmitedIndicesCount)
         Flush();
+
+    if(!geometry.m_Ranges.Size())
+        return;
+
+    SubmitRanges(geometry.m_Vertices, geometry.m_Indices, {geometry.m_Ranges.Data(), geometry.m_Ranges.Size()});
+}
+
+void LineRenderer::DrawStreaming(StreamingPolyline &polyline){
+    SX_CORE_ASSERT(m_Mode == LineMode::Native, "LineRenderer: Streaming polylines are supported only in Native mode");
+
+    if(m_Context)
+        RecordPendingLines();
+    else if(CurrentFrame().Staging().SubmitedIndicesCount)
+        Flush();
+
+    if(polyline.m_Size < 2)
+        return;
+
+    StaticGeometry::Range range;
+    range.FirstIndex = (u32)polyline.m_First;
+    range.IndicesCount = (u32)polyline.m_Size;
+    range.LineWidth = polyline.m_LineWidth;
+
+    StagePolyline(polyline);
+
+    if(m_Context)
+        m_RecordedDraws.Add({polyline.m_Vertices, polyline.m_Indices, range.FirstIndex, range.IndicesCount, range.LineWidth});
+    else
+        SubmitRanges(polyline.m_Vertices, polyline.m_Indices, {&range, 1});
+
+    SX_2D_STATS(m_Stats.Primitives += polyline.m_Size - 1);
+}
+
+void LineRenderer::SubmitRanges(const Buffer *vertices, const Buffer *indices, ConstSpan<StaticGeometry::Range> ranges){
+    Submission &frame = CurrentSubmission();
+
+    {
+        SX_2D_STATS_TIMER(m_Stats.FenceWaitNanoseconds);
+        frame.DrawingFence.WaitAndReset();
+    }
+
+    UploadViewports(frame);
+
+    frame.CmdBuffer->Reset();
+    frame.CmdBuffer->Begin();
+    RecordStreamingUploads(frame.CmdBuffer);
+    {
+        frame.CmdBuffer->Bind(m_Pipeline);
+        frame.CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
+            frame.CmdBuffer->BindVertexBuffer(vertices);
+            frame.CmdBuffer->BindIndexBuffer(indices, IndicesType::Uint32);
+            for(size_t i = 0; i<m_Viewports.Size(); i++){
+                SetViewport(frame.CmdBuffer, m_Viewports[i]);
+                frame.CmdBuffer->Bind(frame.Viewports[i].Set);
+                for(const StaticGeometry::Range &range: ranges){
+                    frame.CmdBuffer->SetLineWidth(range.LineWidth);
+                    frame.CmdBuffer->DrawIndexed(range.IndicesCount, range.FirstIndex);
+                }
+            }
+        frame.CmdBuffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.DrawCalls += ranges.Size() * m_Viewports.Size());
+    }
+    frame.CmdBuffer->End();
+
+    GPU::Execute(frame.CmdBuffer, *m_SemaphoreRing.Current(), *m_SemaphoreRing.Next(), frame.DrawingFence);
+    m_SemaphoreRing.Advance();
+
+    m_FramesStats.SubmittedFrames++;
+    SX_2D_STATS(m_Stats.Batches++);
+
+    AdvanceFrame();
+}
+
+void LineRenderer::StagePolyline(StreamingPolyline &polyline){
+    const size_t capacity = polyline.m_Capacity;
+
+    size_t slot = (polyline.m_First + polyline.m_Size + capacity - polyline.m_PendingCount) % capacity;
+    size_t left = polyline.m_PendingCount;
+
+    while(left){
+        // uploads never cross the end of the ring, so a wrapped run takes two of them
+        const size_t count = Math::Min(left, capacity - slot);
+        const size_t size  = count * sizeof(LineVertex);
+
+        size_t offset = 0;
+        Buffer *staging = ReserveStreamingStaging(size, offset);
+        staging->Copy(&polyline.m_Points[slot], size, offset);
+
+        m_StreamingUploads.Add({staging, polyline.m_Vertices, offset, slot * sizeof(LineVertex), size});
+        SX_2D_STATS(m_Stats.BytesUploaded += size);
+
+        slot = (slot + count) % capacity;
+        left -= count;
     }
-    Batch &batch = m_BatchRing.Current();
 
-    batch.LineWidth = width;
+    polyline.m_PendingCount = 0;
+}
 
-    Vector2f offset = Vector2f(m_Framebuffer->Size()/2u) - m_CurrentViewport.Offset;
+void LineRenderer::RecordStreamingUploads(CommandBuffer *cmd_buffer){
+    for(const StreamingUpload &upload: m_StreamingUploads)
+        cmd_buffer->Copy(upload.Staging, upload.Vertices, upload.Size, upload.StagingOffset, upload.VerticesOffset);
 
-    for(const Vector2s &point: points){
-        LineVertex vertex;
-        vertex.a_Position = (Vector2f(point) - offset) * m_CurrentViewport.Scale;
-        vertex.a_Color = color.RGBA8();
+    m_StreamingUploads.Clear();
+}
 
-        batch.Vertices[batch.SubmitedVerticesCount] = vertex;
-        batch.Indices[batch.SubmitedIndicesCount] = (u32)batch.SubmitedVerticesCount;
+Buffer *LineRenderer::ReserveStreamingStaging(size_t size, size_t &offset){
+    Frame &frame = CurrentFrame();
 
-        batch.SubmitedVerticesCount++;
-        batch.SubmitedIndicesCount++;
+    while(frame.StreamingChunk < frame.StreamingChunks.Size()){
+        Buffer *chunk = frame.StreamingChunks[frame.StreamingChunk];
+
+        if(chunk->Size() - frame.StreamingOffset >= size){
+            offset = frame.StreamingOffset;
+            frame.StreamingOffset += size;
+            return chunk;
+        }
+
+        frame.StreamingChunk++;
+        frame.StreamingOffset = 0;
     }
 
-    batch.Indices[batch.SubmitedIndicesCount++] = 0xFFFFFFFF;
+    frame.StreamingChunks.Add(Buffer::Create(Math::Max(size, StreamingChunkSize), BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource));
+
+    offset = 0;
+    frame.StreamingOffset = size;
+    return frame.StreamingChunks.Last();
+}
+
+void LineRenderer::ResetStreamingStaging(){
+    CurrentFrame().StreamingChunk  = 0;
+    CurrentFrame().StreamingOffset = 0;
 }
 
 void LineRenderer::Flush(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore){
-    m_DrawingFence.WaitAndReset();
+    Submission &frame = CurrentSubmission();
+    Batch &batch = CurrentFrame().Staging();
 
-    Batch &batch = m_BatchRing.Current();
+    // DrawStatic and DrawStreaming leave an empty batch behind, it's submitted only to keep the semaphore chain
+    const bool is_empty = !batch.SubmitedIndicesCount && !batch.SubmitedSegmentsCount;
 
-    SX_CORE_ASSERT(batch.LineWidth != InvalidLineWidth, "Can't flush batch with invalid line width");
+    SX_CORE_ASSERT(is_empty || m_Mode == LineMode::Expanded || batch.LineWidth != InvalidLineWidth, "Can't flush batch with invalid line width");
 
-    m_MatricesUniformBuffer->Copy(&m_MatricesUniform, sizeof(m_MatricesUniform));
+    {
+        SX_2D_STATS_TIMER(m_Stats.FenceWaitNanoseconds);
+        // frame was already waited for when it became current, this only resets the fence
+        frame.DrawingFence.WaitAndReset();
+    }
 
+    if(!is_empty)
+        UploadViewports(frame);
 
-    m_CmdBuffer->Reset();
-    m_CmdBuffer->Begin();
+    frame.CmdBuffer->Reset();
+    frame.CmdBuffer->Begin();
 
     if(batch.SubmitedIndicesCount && batch.SubmitedVerticesCount){
-        m_CmdBuffer->Copy(batch.VerticesBuffer, m_VertexBuffer, batch.SubmitedVerticesCount * sizeof(LineVertex));
-        m_CmdBuffer->Copy(batch.IndicesBuffer, m_IndexBuffer, batch.SubmitedIndicesCount * sizeof(u32));
-        m_CmdBuffer->SetScissor (m_CurrentViewport.ViewportOffset.x, m_CurrentViewport.ViewportOffset.y, m_CurrentViewport.ViewportSize.x, m_CurrentViewport.ViewportSize.y);
-        m_CmdBuffer->SetViewport(m_CurrentViewport.ViewportOffset.x, m_CurrentViewport.ViewportOffset.y, m_CurrentViewport.ViewportSize.x, m_CurrentViewport.ViewportSize.y);
-        m_CmdBuffer->SetLineWidth(batch.LineWidth);
-        m_CmdBuffer->Bind(m_Pipeline);
-        m_CmdBuffer->Bind(m_Set);
-        m_CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
-            m_CmdBuffer->BindVertexBuffer(m_VertexBuffer);
-            m_CmdBuffer->BindIndexBuffer(m_IndexBuffer, IndicesType::Uint32);
-            m_CmdBuffer->DrawIndexed(batch.SubmitedIndicesCount);
-        m_CmdBuffer->EndRenderPass();
+        frame.CmdBuffer->Copy(batch.VerticesBuffer, batch.VertexBuffer, batch.SubmitedVerticesCount * sizeof(LineVertex));
+        frame.CmdBuffer->Copy(batch.IndicesBuffer, batch.IndexBuffer, batch.SubmitedIndicesCount * sizeof(u32));
+        frame.CmdBuffer->SetLineWidth(batch.LineWidth);
+        frame.CmdBuffer->Bind(m_Pipeline);
+        frame.CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
+            frame.CmdBuffer->BindVertexBuffer(batch.VertexBuffer);
+            frame.CmdBuffer->BindIndexBuffer(batch.IndexBuffer, IndicesType::Uint32);
+            for(size_t i = 0; i<m_Viewports.Size(); i++){
+                SetViewport(frame.CmdBuffer, m_Viewports[i]);
+                frame.CmdBuffer->Bind(frame.Viewports[i].Set);
+                frame.CmdBuffer->DrawIndexed(batch.SubmitedIndicesCount);
+            }
+        frame.CmdBuffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.BytesUploaded += batch.SubmitedVerticesCount * sizeof(LineVertex) + batch.SubmitedIndicesCount * sizeof(u32));
+        SX_2D_STATS(m_Stats.DrawCalls += m_Viewports.Size());
     }
 
-    m_CmdBuffer->End();
+    if(batch.SubmitedSegmentsCount){
+        frame.CmdBuffer->Copy(batch.SegmentsBuffer, batch.SegmentBuffer, batch.SubmitedSegmentsCount * sizeof(LineSegment));
+        frame.CmdBuffer->Bind(m_Pipeline);
+        frame.CmdBuffer->BeginRenderPass(m_FramebufferPass, m_Framebuffer);
+            frame.CmdBuffer->BindIndexBuffer(m_QuadIndexBuffer, IndicesType::Uint32);
+            for(size_t i = 0; i<m_Viewports.Size(); i++){
+                SetViewport(frame.CmdBuffer, m_Viewports[i]);
+                frame.CmdBuffer->Bind(frame.Viewports[i].Set);
+                frame.CmdBuffer->DrawIndexed(batch.SubmitedSegmentsCount * 6);
+            }
+        frame.CmdBuffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.BytesUploaded += batch.SubmitedSegmentsCount * sizeof(LineSegment));
+        SX_2D_STATS(m_Stats.DrawCalls += m_Viewports.Size());
+    }
+
+    frame.CmdBuffer->End();
+
+    GPU::Execute(frame.CmdBuffer, *wait_semaphore, *signal_semaphore, frame.DrawingFence);
 
-    GPU::Execute(m_CmdBuffer, *wait_semaphore, *signal_semaphore, m_DrawingFence);
+    m_FramesStats.SubmittedFrames++;
+    SX_2D_STATS(m_Stats.Batches++);
+
+    AdvanceFrame();
+}
+
+void LineRenderer::UploadViewports(Submission &submission){
+    for(size_t i = 0; i<m_Viewports.Size(); i++){
+        submission.Viewports[i].MatricesUniformBuffer->Copy(&m_ViewportUniforms[i], sizeof(ViewUniform));
+        SX_2D_STATS(m_Stats.BytesUploaded += sizeof(ViewUniform));
+    }
+}
+
+void LineRenderer::SetViewport(CommandBuffer *cmd_buffer, const ViewportParameters &viewport){
+    cmd_buffer->SetScissor (viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+    cmd_buffer->SetViewport(viewport.ViewportOffset.x, viewport.ViewportOffset.y, viewport.ViewportSize.x, viewport.ViewportSize.y);
+}
+
+void LineRenderer::SetCullingViewport(Vector2u framebuffer_size, const ViewportParameters &viewport){
+    m_FramebufferSize = Vector2f(framebuffer_size);
+    m_CullingBounds = CullingBounds::Centered(m_FramebufferSize);
+
+    m_Viewports.Clear();
+    m_Viewports.Add(viewport);
+}
+
+bool LineRenderer::IsSegmentVisible(Vector2f first, Vector2f last, float extent)const{
+    if(!m_CullingBounds.Enabled)
+        return true;
+
+    for(const ViewportParameters &viewport: m_Viewports){
+        Vector2f offset = Vector2f(Vector2u(m_FramebufferSize)/2u) - viewport.Offset;
+
+        if(m_CullingBounds.IsSegmentVisible((first - offset) * viewport.Scale, (last - offset) * viewport.Scale, extent))
+            return true;
+    }
+    return false;
+}
+
+void LineRenderer::AdvanceFrame(){
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+
+    Submission &submission = CurrentSubmission();
+
+    if(!submission.DrawingFence.IsSignaled())
+        m_FramesStats.RingExhausted++;
+    {
+        SX_2D_STATS_TIMER(m_Stats.FenceWaitNanoseconds);
+        // staging memory of this frame can't be touched until GPU is done copying from it
+        submission.DrawingFence.WaitFor();
+    }
 
-    batch.Reset();
-    m_BatchRing.Advance();
+    CurrentFrame().Staging().Reset();
+    ResetStreamingStaging();
+}
+
+void LineRenderer::NextBatch(){
+    if(!m_Context){
+        Flush();
+        return;
+    }
+
+    RecordPendingLines();
+
+    Frame &frame = CurrentFrame();
+    if(++frame.CurrentBatch == frame.Batches.Size())
+        frame.Batches.Add(new Batch(m_Mode));
+
+    frame.Staging().Reset();
+    m_RecordedCount = 0;
+}
+
+void LineRenderer::RecordPendingLines(){
+    Batch &batch = CurrentFrame().Staging();
+
+    if(m_Mode == LineMode::Expanded){
+        if(batch.SubmitedSegmentsCount == m_RecordedCount)
+            return;
+
+        m_RecordedDraws.Add({batch.SegmentBuffer, m_QuadIndexBuffer, (u32)(m_RecordedCount * 6), (u32)((batch.SubmitedSegmentsCount - m_RecordedCount) * 6), 1});
+        m_RecordedCount = batch.SubmitedSegmentsCount;
+    }else{
+        if(batch.SubmitedIndicesCount == m_RecordedCount)
+            return;
+
+        m_RecordedDraws.Add({batch.VertexBuffer, batch.IndexBuffer, (u32)m_RecordedCount, (u32)(batch.SubmitedIndicesCount - m_RecordedCount), batch.LineWidth});
+        m_RecordedCount = batch.SubmitedIndicesCount;
+    }
+}
+
+void LineRenderer::CmdRender(Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+    MergeRecorders();
+    RecordPendingLines();
+
+    Frame &frame = CurrentFrame();
+
+    for(size_t i = 0; i<=frame.CurrentBatch; i++){
+        const Batch &batch = *frame.Batches[i];
+
+        if(batch.SubmitedVerticesCount && batch.SubmitedIndicesCount){
+            cmd_buffer->Copy(batch.VerticesBuffer, batch.VertexBuffer, batch.SubmitedVerticesCount * sizeof(LineVertex));
+            cmd_buffer->Copy(batch.IndicesBuffer, batch.IndexBuffer, batch.SubmitedIndicesCount * sizeof(u32));
+            SX_2D_STATS(m_Stats.BytesUploaded += batch.SubmitedVerticesCount * sizeof(LineVertex) + batch.SubmitedIndicesCount * sizeof(u32));
+        }
+
+        if(batch.SubmitedSegmentsCount){
+            cmd_buffer->Copy(batch.SegmentsBuffer, batch.SegmentBuffer, batch.SubmitedSegmentsCount * sizeof(LineSegment));
+            SX_2D_STATS(m_Stats.BytesUploaded += batch.SubmitedSegmentsCount * sizeof(LineSegment));
+        }
+    }
+
+    RecordStreamingUploads(cmd_buffer);
+
+    if(m_RecordedDraws.Size()){
+        cmd_buffer->Bind(m_Pipeline);
+        cmd_buffer->BeginRenderPass(m_FramebufferPass, fb);
+            SetViewport(cmd_buffer, viewport);
+
+            // batches spilled past their limits, static and streaming geometry are separate draws of the same pass
+            const Buffer *bound_vertices = nullptr;
+            const Buffer *bound_indices  = nullptr;
+            DescriptorSet *set = nullptr;
+            u32 line_width = InvalidLineWidth;
+            for(const RecordedDraw &draw: m_RecordedDraws){
+                // segments are read through the set, Native mode needs just one for the view
+                if(!set || (m_Mode == LineMode::Expanded && bound_vertices != draw.Vertices)){
+                    set = context.AllocSet(m_SetLayout);
+                    set->UpdateUniformBinding(0, 0, context.ViewUniformBuffer());
+                    if(m_Mode == LineMode::Expanded)
+                        set->UpdateStorageBufferBinding(1, 0, draw.Vertices);
+                    cmd_buffer->Bind(set);
+                    SX_2D_STATS(m_Stats.DescriptorWrites += m_Mode == LineMode::Expanded ? 2 : 1);
+                }
+
+                if(m_Mode == LineMode::Native && bound_vertices != draw.Vertices)
+                    cmd_buffer->BindVertexBuffer(draw.Vertices);
+                bound_vertices = draw.Vertices;
+
+                if(bound_indices != draw.Indices){
+                    cmd_buffer->BindIndexBuffer(draw.Indices, IndicesType::Uint32);
+                    bound_indices = draw.Indices;
+                }
+
+                if(m_Mode == LineMode::Native && line_width != draw.LineWidth){
+                    cmd_buffer->SetLineWidth(draw.LineWidth);
+                    line_width = draw.LineWidth;
+                }
+
+                cmd_buffer->DrawIndexed(draw.IndicesCount, draw.FirstIndex);
+            }
+        cmd_buffer->EndRenderPass();
+
+        SX_2D_STATS(m_Stats.DrawCalls += m_RecordedDraws.Size());
+    }
+
+    SX_2D_STATS(m_Stats.Batches += frame.CurrentBatch + 1);
+
+    m_RecordedDraws.Clear();
+    m_RecordedCount = 0;
+
+    // context has already waited for the next frame when it gets drawn into
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+    CurrentFrame().CurrentBatch = 0;
+    CurrentFrame().Staging().Reset();
+    ResetStreamingStaging();
+
+    m_LastFrameStats = m_Stats;
+    m_Stats = {};
+}
+
+void LineRenderer::Submit(const DrawRecorder *recorder){
+    m_Recorders.Add(recorder);
+}
+
+void LineRenderer::MergeRecorders(){
+    for(const DrawRecorder *recorder: m_Recorders){
+        for(const DrawRecorder::PolylineRecord &polyline: recorder->Polylines())
+            CopyPolyline(recorder->PolylineVertices(polyline), polyline.Width);
+    }
+
+    m_Recorders.Clear();
+}
+
+void LineRenderer::CopyPolyline(ConstSpan<LineVertex> vertices, u32 width){
+    if(vertices.Size() < 2)
+        return;
+
+    SX_2D_STATS(m_Stats.Primitives += vertices.Size() - 1);
+
+    if(m_Mode == LineMode::Expanded){
+        for(size_t i = 1; i<vertices.Size(); i++){
+            if(CurrentFrame().Staging().IsSegmentsFull())
+                NextBatch();
+
+            Batch &batch = CurrentFrame().Staging();
+
+            batch.Segments[batch.SubmitedSegmentsCount++] = MakeSegment([&](size_t j){ return vertices[j].a_Position; }, vertices.Size(), i, width, m_LineJoin, vertices[i].a_Color);
+        }
+        return;
+    }
+
+    const LineVertex *strip = vertices.Pointer();
+    size_t left = vertices.Size();
+
+    while(left >= 2){
+        Batch &batch = StripBatch(width);
+
+        const size_t count = Math::Min(left, batch.StripRoom());
+
+        Memory::Copy(strip, batch.Vertices + batch.SubmitedVerticesCount, count * sizeof(LineVertex));
+
+        for(size_t i = 0; i<count; i++)
+            batch.Indices[batch.SubmitedIndicesCount++] = (u32)(batch.SubmitedVerticesCount + i);
+        batch.Indices[batch.SubmitedIndicesCount++] = 0xFFFFFFFF;
+
+        batch.SubmitedVerticesCount += count;
+
+        // the next batch starts from the last copied vertex, so the strip goes on without a gap
+        strip += count - 1;
+        left  -= count - 1;
+    }
+}
+
+LineRenderer::Batch &LineRenderer::StripBatch(u32 width){
+    Batch &batch = CurrentFrame().Staging();
+
+    if(batch.StripRoom() < 2){
+        NextBatch();
+    }else if(batch.LineWidth != InvalidLineWidth && batch.LineWidth != width){
+        // recorded frames only end the draw, following lines go on in the same batch
+        if(m_Context)
+            RecordPendingLines();
+        else
+            Flush();
+    }
+
+    CurrentFrame().Staging().LineWidth = width;
+
+    return CurrentFrame().Staging();
 }
 
 void LineRenderer::Flush() {
+    // attached renderer is submitted by Renderer2D's EndFrame
+    if(m_Context){
+        RecordPendingLines();
+        return;
+    }
+
     Flush(m_SemaphoreRing.Current(), m_SemaphoreRing.Next());
     m_SemaphoreRing.Advance();
 }
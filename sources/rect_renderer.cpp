@@ -1,149 +1,721 @@
 #include "2d/rect_renderer.hpp"
+#include "2d/draw_capture.hpp"
+#include "2d/draw_recorder.hpp"
+#include "2d/common/shader_cache.hpp"
+#include "2d/common/quad_index_buffer.hpp"
+#include "common/simd.hpp"
+#include "common/packing.hpp"
 #include "core/string.hpp"
+#include "core/assert.hpp"
+#include "core/os/memory.hpp"
 #include "core/ranges/algorithm.hpp"
 #include "core/math/functions.hpp"
 #include "core/math/linear.hpp"
 #include "graphics/api/gpu.hpp"
 #include "graphics/api/render_pass.hpp"
 #include "graphics/api/framebuffer.hpp"
+#include <cstddef>
+#include <cmath>
 
 
 static const char *s_VertexShader = 
+#if SX_2D_COMPACT_INSTANCES
+    #include "shaders/rect_renderer_compact.vert.glsl"
+#else
     #include "shaders/rect_renderer.vert.glsl"
+#endif
 ;
 
 static const char *s_FragmentShader = 
     #include "shaders/rect_renderer.frag.glsl"
 ;
 
-static Array<VertexAttribute, 4> s_VertexAttributes = {
-    VertexAttribute::Float32x2,
-    VertexAttribute::Float32x2,
-    VertexAttribute::UNorm8x4,
-    VertexAttribute::Float32x1
-};
-
-RectRenderer::Batch::Batch(u16 primitives_count):
-    Vertices(new RectVertex[(size_t)primitives_count * 4]),
-    Indices(new u16[(size_t)primitives_count * 6]),
-    VertexBuffer(
-        Buffer::Create(sizeof(RectVertex) * primitives_count * 4, BufferMemoryType::DynamicVRAM, BufferUsageBits::VertexBuffer | BufferUsageBits::TransferDestination)
-    ),
-    IndexBuffer(
-        Buffer::Create(sizeof(u16) * primitives_count * 6, BufferMemoryType::DynamicVRAM, BufferUsageBits::IndexBuffer | BufferUsageBits::TransferDestination)
-    )
-{}
+static const char *s_BindlessFragmentShader = 
+    #include "shaders/rect_renderer_bindless.frag.glsl"
+;
 
+static DescriptorSetLayout *CreateSetLayout(size_t textures_count){
+    return DescriptorSetLayout::Create({
+        ShaderBinding(0, 1,              ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
+        ShaderBinding(1, textures_count, ShaderBindingType::Texture,       ShaderStageBits::Fragment),
+        ShaderBinding(2, 1,              ShaderBindingType::StorageBuffer, ShaderStageBits::Vertex)
+    });
+}
 
-bool RectRenderer::Batch::IsFull()const {
-    return Textures.Size() == Textures.Capacity() || SubmitedPrimitives == MaxPrimitivesCount();
+#if SX_2D_COMPACT_INSTANCES
+RectRenderer::RectInstance RectRenderer::RectInstance::Make(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, Vector2f tex_coords_min, Vector2f tex_coords_max, u32 tex_index){
+    SX_CORE_ASSERT(tex_coords_min.x >= 0.f && tex_coords_min.y >= 0.f && tex_coords_max.x <= 1.f && tex_coords_max.y <= 1.f
+        && tex_coords_max.x >= 0.f && tex_coords_max.y >= 0.f && tex_coords_min.x <= 1.f && tex_coords_min.y <= 1.f,
+        "RectRenderer: Compact instances support texture coordinates only within [0, 1], repeating and mirroring needs full instances");
+
+    float turns = angle / 360.f;
+    // floor keeps angles beyond s32 range defined, wrapping of 1.0 is done by the mask below
+    turns -= std::floor(turns);
+
+    RectInstance instance;
+    instance.a_Position = position;
+    instance.a_Size   = PackHalf2x16(size.x, size.y);
+    instance.a_Origin = PackHalf2x16(origin.x, origin.y);
+    instance.a_AngleAndTexIndex = ((u32)(turns * 65536.f) & 0xFFFF) | (tex_index << 16);
+    instance.a_Color = color;
+    instance.a_TexCoordsMin = PackUnorm2x16(tex_coords_min.x, tex_coords_min.y);
+    instance.a_TexCoordsMax = PackUnorm2x16(tex_coords_max.x, tex_coords_max.y);
+    return instance;
 }
+#endif
 
-static void Rotate(Span<Vector2f> vertices, float degrees){
-    float radians = Math::Rad(degrees);
+RectRenderer::UploadArena::~UploadArena(){
+    delete Staging;
+    delete Device;
+}
 
-    Vector2f mat[2];
-    mat[0][0] = Math::Cos(radians);
-    mat[0][1] =-Math::Sin(radians);
-    mat[1][0] = Math::Sin(radians);
-    mat[1][1] = Math::Cos(radians);
+void RectRenderer::UploadArena::Reserve(size_t capacity){
+    if(capacity <= Capacity)
+        return;
 
-    for(auto &vertex: vertices){
-        vertex = Vector2f(
-            Dot(mat[0], vertex),
-            Dot(mat[1], vertex)
-        );
-    }
+    SX_CORE_ASSERT(capacity <= QuadIndexBuffer::MaxQuadsCount, "RectRenderer: UploadArena can't be larger than QuadIndexBuffer");
+
+    Buffer *staging = Buffer::Create(sizeof(RectInstance) * capacity, BufferMemoryType::UncachedRAM, BufferUsageBits::TransferSource);
+    RectInstance *instances = staging->Map<RectInstance>();
+
+    if(Size)
+        Memory::Copy(Instances, instances, Size * sizeof(RectInstance));
+
+    delete Staging;
+
+    Staging = staging;
+    Instances = instances;
+    Capacity = capacity;
 }
 
-void RectRenderer::Batch::PushRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D* texture, const Array<Vector2f, 4>& texture_coords) {
-     
-    size_t texture_index = Textures | IndexOf(texture);
+void RectRenderer::UploadArena::Release(){
+    SX_CORE_ASSERT(!Size, "RectRenderer: UploadArena should be empty to be released");
 
-    if (texture_index == -1) {
-        texture_index = Textures.Size();
-        Textures.Add(texture);
-    }
+    delete Staging;
+    delete Device;
 
-    size_t base_vertex = SubmitedPrimitives * 4;
-    size_t base_index  = SubmitedPrimitives * 6;
+    Staging = nullptr;
+    Device = nullptr;
+    Instances = nullptr;
+    Capacity = 0;
+}
 
-    Array<Vector2f, 4> rect_vertices = {
-        Vector2f(0,      0         ) - Vector2f(origin),
-        Vector2f(size.x, 0         ) - Vector2f(origin),
-        Vector2f(size.x, 0 + size.y) - Vector2f(origin),
-        Vector2f(0,      0 + size.y) - Vector2f(origin)
-    };
+RectRenderer::RectInstance &RectRenderer::UploadArena::Push(){
+    return *Push(1);
+}
 
-    Rotate(rect_vertices, angle);
+RectRenderer::RectInstance *RectRenderer::UploadArena::Push(size_t count){
+    if(Size + count > Capacity)
+        Reserve(Math::Min(Math::Max(Capacity * 2, Size + count), (size_t)QuadIndexBuffer::MaxQuadsCount));
 
-    Vertices[base_vertex + 0] = {rect_vertices[0] + position, texture_coords[0], color.RGBA8(), (float)texture_index};
-    Vertices[base_vertex + 1] = {rect_vertices[1] + position, texture_coords[1], color.RGBA8(), (float)texture_index};
-    Vertices[base_vertex + 2] = {rect_vertices[2] + position, texture_coords[2], color.RGBA8(), (float)texture_index};
-    Vertices[base_vertex + 3] = {rect_vertices[3] + position, texture_coords[3], color.RGBA8(), (float)texture_index};
+    SX_CORE_ASSERT(Size + count <= Capacity, "RectRenderer: Rects should be pushed only into chunk's remaining room");
 
-    Indices[base_index + 0] = SubmitedPrimitives * 4 + 0;
-    Indices[base_index + 1] = SubmitedPrimitives * 4 + 1;
-    Indices[base_index + 2] = SubmitedPrimitives * 4 + 2;
+    RectInstance *instances = Instances + Size;
+    Size += count;
+    return instances;
+}
 
-    Indices[base_index + 3] = SubmitedPrimitives * 4 + 2;
-    Indices[base_index + 4] = SubmitedPrimitives * 4 + 3;
-    Indices[base_index + 5] = SubmitedPrimitives * 4 + 0;
+RectRenderer::Frame::~Frame(){
+    for (UploadArena *chunk : Chunks)
+        delete chunk;
+}
 
-    SubmitedPrimitives++;
+bool RectRenderer::Batch::IsFull(size_t max_primitives, size_t new_textures)const {
+    return (!IsBindless && Textures.Size() + new_textures > Textures.Capacity()) || InstancesCount == max_primitives;
 }
 
-u16 RectRenderer::Batch::MaxPrimitivesCount()const {
-    return VertexBuffer->Size() / sizeof(RectVertex) / 4;
+u32 RectRenderer::Batch::TextureIndex(const Texture2D *texture){
+    size_t texture_index = Textures | IndexOf(texture);
+
+    if (texture_index == -1) {
+        texture_index = Textures.Size();
+        Textures.Add(texture);
+    }
+
+    return (u32)texture_index;
 }
 
-const Array<Vector2f, 4> RectRenderer::s_DefaultTextureCoordinates = {
-    Vector2f(0.f, 0.f),
-    Vector2f(1.f, 0.f),
-    Vector2f(1.f, 1.f),
-    Vector2f(0.f, 1.f)
-};                 
+bool RectRenderer::CachedSet::Matches(u64 hash, const Batch &batch, const Sampler *sampler)const{
+    if (Hash != hash || TextureSampler != sampler || Textures.Size() != batch.Textures.Size())
+        return false;
 
-RectRenderer::RectRenderer(const RenderPass *rp):
+    for (size_t i = 0; i < Textures.Size(); i++) {
+        if (Textures[i] != batch.Textures[i])
+            return false;
+    }
+    return true;
+}
+
+RectRenderer::RectRenderer(const RenderPass *rp, size_t frames_in_flight, TexturingMode mode, size_t primitives_in_batch):
+    m_TexturingMode(mode),
     m_SetLayout(
-        DescriptorSetLayout::Create({
-            ShaderBinding(0, 1,                                       ShaderBindingType::UniformBuffer, ShaderStageBits::Vertex),
-            ShaderBinding(1, RectRenderer::Batch::MaxTexturesInBatch, ShaderBindingType::Texture,       ShaderStageBits::Fragment)
-        })
+        CreateSetLayout(Batch::MaxTexturesInBatch)
     ),
-    m_Pipeline(nullptr)
+    m_Pipeline(nullptr),
+    m_Frames(new Frame[frames_in_flight]),
+    m_FramesCount(frames_in_flight),
+    m_PrimitivesInBatch(primitives_in_batch),
+    m_ReservedPrimitives(primitives_in_batch)
 {
+    SX_CORE_ASSERT(frames_in_flight, "RectRenderer: at least one frame in flight is required");
+    SX_CORE_ASSERT(primitives_in_batch && primitives_in_batch <= QuadIndexBuffer::MaxQuadsCount, "RectRenderer: batch size should fit QuadIndexBuffer");
+
     m_FramebufferPass = rp;
-    
-    Array<const Shader*, 2> shaders;
-    shaders[0] = Shader::Create(ShaderStageBits::Vertex,   {s_VertexShader,   String::Length(s_VertexShader)  } );
-    shaders[1] = Shader::Create(ShaderStageBits::Fragment, {s_FragmentShader, String::Length(s_FragmentShader)} );
+    m_IndexBuffer = QuadIndexBuffer::Acquire();
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        Frame &frame = m_Frames[i];
+
+        frame.Chunks.Add(new UploadArena());
+        frame.Arena().Reserve(m_PrimitivesInBatch);
+        frame.SetPool = new SingleFrameDescriptorSetPool({MaxSets, m_SetLayout.Get()}, PreallocatedSets);
+    }
+
+    m_Shaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_VertexShader);
+    m_Shaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_FragmentShader);
 
     {
         GraphicsPipelineProperties props;
-        props.Shaders = shaders;
-        props.VertexAttributes = s_VertexAttributes;
+        props.Shaders = m_Shaders;
         props.Pass = m_FramebufferPass;
         props.Layout = m_SetLayout.Get();
 
         m_Pipeline = GraphicsPipeline::Create(props);
     }
+
+    if (m_TexturingMode == TexturingMode::Bindless) {
+        // without partially bound descriptors every entry of the table is statically used,
+        // so the whole table has to fit the device and be written
+        m_TableSize = Math::Min(MaxTexturesInTable, (size_t)GPU::MaxTexturesPerStage());
+        m_BindlessSetLayout = CreateSetLayout(m_TableSize);
+        m_BindlessSetPool = DescriptorSetPool::Create({m_FramesCount, m_BindlessSetLayout.Get()});
+
+        for (size_t i = 0; i < m_FramesCount; i++) {
+            DescriptorSet *set = m_BindlessSetPool->Alloc();
+            for (size_t j = 0; j < m_TableSize; j++)
+                set->UpdateTextureBinding(1, j, Texture2D::White(), m_DefaultSampler.Get());
+            set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
+
+            m_Frames[i].Bindless.Set = set;
+            m_Frames[i].BindlessSetPool = new SingleFrameDescriptorSetPool({MaxSets, m_BindlessSetLayout.Get()}, 0);
+        }
+
+        m_BindlessShaders[0] = ShaderCache::Acquire(ShaderStageBits::Vertex, s_VertexShader);
+        m_BindlessShaders[1] = ShaderCache::Acquire(ShaderStageBits::Fragment, s_BindlessFragmentShader);
+
+        GraphicsPipelineProperties props;
+        props.Shaders = m_BindlessShaders;
+        props.Pass = m_FramebufferPass;
+        props.Layout = m_BindlessSetLayout.Get();
+
+        m_BindlessPipeline = GraphicsPipeline::Create(props);
+    }
+}
+
+RectRenderer::~RectRenderer(){
+    if (m_BindlessSetPool) {
+        for (size_t i = 0; i < m_FramesCount; i++)
+            m_BindlessSetPool->Free(m_Frames[i].Bindless.Set);
+    }
+
+    for (size_t i = 0; i < m_CachedSlots.Size(); i++)
+        m_CachedSetPools[i / m_FramesCount / CachedSetsInPool]->Free(m_CachedSlots[i].Set);
+
+    // pipelines should go before shaders they were created from
+    m_Pipeline = nullptr;
+    m_BindlessPipeline = nullptr;
+
+    for (auto shader : m_Shaders)
+        ShaderCache::Release(shader);
+
+    for (auto shader : m_BindlessShaders) {
+        if (shader)
+            ShaderCache::Release(shader);
+    }
+
+    QuadIndexBuffer::Release();
+}
+
+void RectRenderer::ResetTextureTable(){
+    m_TextureTable.Clear();
+    m_TextureTableIndices.clear();
+    m_TextureTableGeneration++;
+    m_IsTableExhausted = false;
+}
+
+void RectRenderer::Reserve(size_t primitives){
+    m_ReservedPrimitives = Math::Min(Math::Max(m_ReservedPrimitives, primitives), (size_t)QuadIndexBuffer::MaxQuadsCount);
+
+    for (size_t i = 0; i < m_FramesCount; i++) {
+        UploadArena &arena = *m_Frames[i].Chunks[0];
+
+        arena.Reserve(m_ReservedPrimitives);
+        ReserveDevice(arena);
+    }
+}
+
+void RectRenderer::ReserveDevice(UploadArena &arena){
+    if (arena.Device && arena.Device->Size() >= arena.Capacity * sizeof(RectInstance))
+        return;
+
+    InvalidateCachedSets(arena.Device);
+    delete arena.Device;
+    arena.Device = Buffer::Create(arena.Capacity * sizeof(RectInstance), BufferMemoryType::VRAM, BufferUsageBits::StorageBuffer | BufferUsageBits::TransferDestination);
+}
+
+void RectRenderer::TrimArena(UploadArena &arena, size_t reserved_primitives){
+    if (!m_TrimFrames || ++arena.FramesSinceTrim < m_TrimFrames)
+        return;
+
+    const size_t capacity = Math::Max(arena.PeakSize, reserved_primitives);
+
+    // arena is released only when at least half of it was idle the whole time, so it doesn't bounce.
+    // Spill chunks have nothing reserved, so an unused one is released entirely
+    if (arena.Capacity && capacity * 2 <= arena.Capacity) {
+        InvalidateCachedSets(arena.Device);
+        arena.Release();
+        arena.Reserve(capacity);
+        if (arena.Capacity)
+            ReserveDevice(arena);
+    }
+
+    arena.PeakSize = 0;
+    arena.FramesSinceTrim = 0;
+}
+
+void RectRenderer::ResetSetCache(){
+    // sets stay allocated and get rewritten when their frame uses them again
+    m_CachedSetIndices.clear();
+
+    for (CachedSet &cached : m_CachedSets) {
+        cached.Hash = 0;
+        cached.Generation = ++m_CachedSetsGeneration;
+    }
+}
+
+void RectRenderer::InvalidateCachedSets(const Buffer *instances){
+    for (CachedSlot &slot : m_CachedSlots) {
+        if (slot.Instances == instances)
+            slot.Instances = nullptr;
+    }
+}
+
+DescriptorSet *RectRenderer::AcquireBatchSet(const Batch &batch, const Buffer *instances){
+    const Sampler *sampler = m_DefaultSampler.Get();
+
+    u64 hash = 14695981039346656037ull;
+    auto hash_pointer = [&hash](const void *pointer) {
+        hash = (hash ^ (u64)pointer) * 1099511628211ull;
+    };
+    for (const Texture2D *texture : batch.Textures)
+        hash_pointer(texture);
+    hash_pointer(sampler);
+    // zero marks invalidated entries
+    hash |= 1;
+
+    size_t index = -1;
+
+    auto it = m_CachedSetIndices.find(hash);
+    if (it != m_CachedSetIndices.end()) {
+        // colliding combinations are left to single frame sets
+        if (m_CachedSets[it->second].Matches(hash, batch, sampler))
+            index = it->second;
+    } else {
+        index = ClaimCachedSet();
+
+        if (index != -1) {
+            CachedSet &cached = m_CachedSets[index];
+            cached.Hash = hash;
+            cached.Textures = batch.Textures;
+            cached.TextureSampler = sampler;
+            cached.Generation = ++m_CachedSetsGeneration;
+
+            m_CachedSetIndices.emplace(hash, index);
+        }
+    }
+
+    if (index == -1)
+        return WriteFrameBatchSet(batch, instances);
+
+    CachedSet &cached = m_CachedSets[index];
+    CachedSlot &slot = m_CachedSlots[index * m_FramesCount + m_CurrentFrame];
+
+    const bool is_outdated = slot.Generation != cached.Generation;
+
+    // set bound earlier in this frame can't be rewritten, like for another chunk's instances
+    if ((is_outdated || slot.Instances != instances) && slot.LastUsedFrame == m_FrameIndex)
+        return WriteFrameBatchSet(batch, instances);
+
+    if (is_outdated) {
+        WriteBatchSet(slot.Set, batch, instances, slot.WrittenTextures);
+
+        slot.Generation = cached.Generation;
+        slot.WrittenTextures = batch.Textures.Size();
+        slot.Instances = instances;
+    } else if (slot.Instances != instances) {
+        slot.Set->UpdateStorageBufferBinding(2, 0, instances);
+        slot.Instances = instances;
+        SX_2D_STATS(m_Stats.DescriptorWrites++);
+    }
+
+    slot.LastUsedFrame = m_FrameIndex;
+    cached.LastUsedFrame = m_FrameIndex;
+
+    return slot.Set;
+}
+
+size_t RectRenderer::ClaimCachedSet(){
+    if (m_CachedSets.Size() < m_MaxCachedSets) {
+        if (m_CachedSets.Size() % CachedSetsInPool == 0)
+            m_CachedSetPools.Add(DescriptorSetPool::Create({CachedSetsInPool * m_FramesCount, m_SetLayout.Get()}));
+
+        m_CachedSets.Add({});
+
+        for (size_t i = 0; i < m_FramesCount; i++) {
+            CachedSlot slot;
+            slot.Set = m_CachedSetPools.Last()->Alloc();
+            slot.Set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
+            SX_2D_STATS(m_Stats.DescriptorWrites++);
+
+            m_CachedSlots.Add(slot);
+        }
+
+        return m_CachedSets.Size() - 1;
+    }
+
+    // slots of other frames are rewritten only when their frame comes around,
+    // so any entry the current frame hasn't used yet can take another key
+    for (size_t i = 0; i < m_CachedSets.Size(); i++) {
+        const size_t index = m_EvictionCursor;
+        m_EvictionCursor = (m_EvictionCursor + 1) % m_CachedSets.Size();
+
+        CachedSet &cached = m_CachedSets[index];
+
+        if (cached.LastUsedFrame < m_FrameIndex) {
+            if (cached.Hash)
+                m_CachedSetIndices.erase(cached.Hash);
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+DescriptorSet *RectRenderer::WriteFrameBatchSet(const Batch &batch, const Buffer *instances){
+    DescriptorSet *set = m_Frames[m_CurrentFrame].SetPool->Alloc();
+    set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
+    SX_2D_STATS(m_Stats.DescriptorWrites++);
+
+    WriteBatchSet(set, batch, instances, 0);
+
+    return set;
+}
+
+void RectRenderer::WriteBatchSet(DescriptorSet *set, const Batch &batch, const Buffer *instances, size_t written_textures){
+    set->UpdateStorageBufferBinding(2, 0, instances);
+
+    for (size_t i = 0; i < batch.Textures.Size(); i++)
+        set->UpdateTextureBinding(1, i, batch.Textures[i], m_DefaultSampler.Get());
+
+    // entries left from the previous key may reference destroyed textures
+    for (size_t i = batch.Textures.Size(); i < written_textures; i++)
+        set->UpdateTextureBinding(1, i, Texture2D::White(), m_DefaultSampler.Get());
+
+    SX_2D_STATS(m_Stats.DescriptorWrites += 1 + Math::Max(batch.Textures.Size(), written_textures));
+}
+
+u32 RectRenderer::TextureIndex(Batch &batch, const Texture2D *texture){
+    if (!batch.IsBindless)
+        return batch.TextureIndex(texture);
+
+    auto it = m_TextureTableIndices.find(texture);
+    if (it != m_TextureTableIndices.end())
+        return it->second;
+
+    SX_CORE_ASSERT(m_TextureTable.Size() < m_TableSize, "RectRenderer: BatchFor should have checked the table's room");
+
+    u32 index = (u32)m_TextureTable.Size();
+    m_TextureTable.Add(texture);
+    m_TextureTableIndices.emplace(texture, index);
+    return index;
+}
+
+DescriptorSet *RectRenderer::UpdateBindlessSet(const Buffer *instances){
+    BindlessFrame &frame = m_Frames[m_CurrentFrame].Bindless;
+
+    // this frame's set is not used by GPU anymore, so only entries added since its last use are written
+    size_t first_outdated = frame.WrittenTextures;
+
+    if (frame.TableGeneration != m_TextureTableGeneration) {
+        // table was reset, entries past its end may reference destroyed textures
+        for (size_t i = m_TextureTable.Size(); i < frame.WrittenTextures; i++)
+            frame.Set->UpdateTextureBinding(1, i, Texture2D::White(), m_DefaultSampler.Get());
+
+        SX_2D_STATS(m_Stats.DescriptorWrites += frame.WrittenTextures > m_TextureTable.Size() ? frame.WrittenTextures - m_TextureTable.Size() : 0);
+
+        first_outdated = 0;
+        frame.TableGeneration = m_TextureTableGeneration;
+    }
+
+    SX_2D_STATS(m_Stats.DescriptorWrites += m_TextureTable.Size() - first_outdated);
+
+    for (size_t i = first_outdated; i < m_TextureTable.Size(); i++)
+        frame.Set->UpdateTextureBinding(1, i, m_TextureTable[i], m_DefaultSampler.Get());
+
+    frame.WrittenTextures = m_TextureTable.Size();
+
+    if (frame.BoundInstances != instances) {
+        frame.Set->UpdateStorageBufferBinding(2, 0, instances);
+        frame.BoundInstances = instances;
+        SX_2D_STATS(m_Stats.DescriptorWrites++);
+    }
+
+    return frame.Set;
+}
+
+DescriptorSet *RectRenderer::WriteSpillBindlessSet(const Buffer *instances){
+    // spill chunks are rare, so their sets live for a single frame and are written from scratch
+    DescriptorSet *set = m_Frames[m_CurrentFrame].BindlessSetPool->Alloc();
+
+    set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
+    set->UpdateStorageBufferBinding(2, 0, instances);
+
+    for (size_t i = 0; i < m_TableSize; i++)
+        set->UpdateTextureBinding(1, i, i < m_TextureTable.Size() ? m_TextureTable[i] : Texture2D::White(), m_DefaultSampler.Get());
+
+    SX_2D_STATS(m_Stats.DescriptorWrites += 2 + m_TableSize);
+
+    return set;
 }
 
 //m_MatricesUniform.u_Projection[0][0] = 2.f/framebuffer->Size().x;
 //m_MatricesUniform.u_Projection[1][1] = 2.f/framebuffer->Size().y;
 
-void RectRenderer::DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture, const Array<Vector2f, 4> &texture_coords){
-    static constexpr size_t MaxPrimitivesInBatch = 6000;
-    if (!m_Batches.Size() || m_Batches.Last().IsFull())
-        m_Batches.Add({ MaxPrimitivesInBatch });
+void RectRenderer::DrawRect(Vector2f position, Vector2f size, Vector2f origin, float angle, Color color, Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max){
+    PushRect(position, size, origin, angle, color.RGBA8(), texture, tex_coords_min, tex_coords_max);
+}
+
+void RectRenderer::PushRect(Vector2f position, Vector2f size, Vector2f origin, float angle, u32 color, const Texture2D *texture, Vector2f tex_coords_min, Vector2f tex_coords_max){
+    if (m_Capture)
+        m_Capture->Rect(position, size, origin, angle, color, texture, tex_coords_min, tex_coords_max);
+
+    m_CullingStats.Submitted++;
+
+    if (!m_CullingBounds.IsRectVisible(position, size, origin, angle)) {
+        m_CullingStats.Culled++;
+        return;
+    }
+
+    Batch &batch = BatchFor({&texture, 1});
+
+    m_Frames[m_CurrentFrame].Arena().Push() = RectInstance::Make(position, size, origin, angle, color, tex_coords_min, tex_coords_max, TextureIndex(batch, texture));
+
+    batch.InstancesCount++;
+
+    SX_2D_STATS(m_Stats.Primitives++);
+}
+
+RectRenderer::Batch &RectRenderer::CurrentBatch(size_t new_textures){
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    if (frame.Arena().Size == QuadIndexBuffer::MaxQuadsCount) {
+        // quad indices can't address past a chunk, so the frame goes on in the next one
+        if (++frame.CurrentChunk == frame.Chunks.Size())
+            frame.Chunks.Add(new UploadArena());
+
+        frame.Arena().Reserve(m_PrimitivesInBatch);
+    }
+
+    const bool is_bindless = m_TexturingMode == TexturingMode::Bindless && !m_IsTableExhausted;
+
+    if (!m_Batches.Size() || m_Batches.Last().IsFull(m_PrimitivesInBatch, new_textures) || m_Batches.Last().Chunk != frame.CurrentChunk || m_Batches.Last().IsBindless != is_bindless)
+        m_Batches.Add({ frame.CurrentChunk, frame.Arena().Size, is_bindless });
+
+    return m_Batches.Last();
+}
+
+RectRenderer::Batch &RectRenderer::BatchFor(ConstSpan<const Texture2D *> textures){
+    Batch &batch = CurrentBatch(textures.Size());
+
+    if (!batch.IsBindless)
+        return batch;
+
+    size_t missing = 0;
+    for (size_t i = 0; i < textures.Size(); i++) {
+        if (m_TextureTableIndices.find(textures[i]) == m_TextureTableIndices.end())
+            missing++;
+    }
+
+    if (m_TextureTable.Size() + missing <= m_TableSize)
+        return batch;
+
+    // fallback lasts until the table is reset, so batches don't alternate between both kinds
+    m_IsTableExhausted = true;
+
+    return CurrentBatch(textures.Size());
+}
+
+void RectRenderer::Submit(const DrawRecorder *recorder){
+    m_Recorders.Add(recorder);
+}
+
+void RectRenderer::MergeRecorders(){
+    SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+
+    for (const DrawRecorder *recorder : m_Recorders)
+        MergeRecorder(*recorder);
 
-    m_Batches.Last().PushRect(position, size, origin, angle, color, texture, texture_coords);
+    m_Recorders.Clear();
+}
+
+void RectRenderer::MergeRecorder(const DrawRecorder &recorder){
+    static_assert(DrawRecorder::MaxTexturesInRange <= Batch::MaxTexturesInBatch, "RectRenderer: recorder's range should fit into a batch");
+
+    for (const DrawRecorder::RectRange &range : recorder.RectRanges()) {
+        const RectInstance *source = recorder.Rects().Pointer() + range.FirstInstance;
+
+        size_t merged = 0;
+        while (merged < range.InstancesCount) {
+            Batch &batch = BatchFor({&range.Textures[0], range.Textures.Size()});
+            UploadArena &arena = m_Frames[m_CurrentFrame].Arena();
+
+            // recorded indices point into the range's list, they are rewritten only when textures land elsewhere
+            u32 remap[DrawRecorder::MaxTexturesInRange];
+            bool is_identity = true;
+            for (size_t i = 0; i < range.Textures.Size(); i++) {
+                remap[i] = TextureIndex(batch, range.Textures[i]);
+                is_identity = is_identity && remap[i] == i;
+            }
+
+            const size_t batch_room = Math::Min(m_PrimitivesInBatch - batch.InstancesCount, QuadIndexBuffer::MaxQuadsCount - arena.Size);
+            const size_t count = Math::Min(range.InstancesCount - merged, batch_room);
+
+            RectInstance *instances = arena.Push(count);
+            Memory::Copy(source + merged, instances, count * sizeof(RectInstance));
+
+            if (!is_identity) {
+                for (size_t i = 0; i < count; i++)
+                    instances[i].SetTexIndex(remap[instances[i].TexIndex()]);
+            }
+
+            batch.InstancesCount += count;
+            merged += count;
+
+            SX_2D_STATS(m_Stats.Primitives += count);
+        }
+    }
+}
+
+void RectRenderer::DrawRects(ConstSpan<Vector2f> positions, ConstSpan<Vector2f> sizes, ConstSpan<float> angles, ConstSpan<Color> colors, Texture2D *texture){
+    const size_t count = positions.Size();
+
+    SX_CORE_ASSERT(sizes.Size() == count && colors.Size() == count && (!angles.Size() || angles.Size() == count), "RectRenderer: DrawRects spans should be of the same size");
+
+    if (m_Capture)
+        m_Capture->Rects(positions, sizes, angles, colors, texture);
+
+    m_CullingStats.Submitted += count;
+
+    if (!m_CullingBounds.Enabled) {
+        PushRects(positions.Pointer(), sizes.Pointer(), angles.Size() ? angles.Pointer() : nullptr, colors.Pointer(), count, texture);
+        return;
+    }
+
+    auto is_visible = [&](size_t i) {
+        return IsVisible(positions[i], sizes[i], angles.Size() ? angles[i] : 0.f);
+    };
+
+    // visible rects are pushed in runs to keep the bulk path for them
+    size_t first = 0;
+    while (first < count) {
+        size_t last = first;
+        while (last < count && is_visible(last))
+            last++;
+
+        PushRects(positions.Pointer() + first, sizes.Pointer() + first, angles.Size() ? angles.Pointer() + first : nullptr, colors.Pointer() + first, last - first, texture);
+
+        first = last;
+        while (first < count && !is_visible(first)) {
+            m_CullingStats.Culled++;
+            first++;
+        }
+    }
+}
+
+void RectRenderer::PushRects(const Vector2f *positions, const Vector2f *sizes, const float *angles, const Color *colors, size_t count, const Texture2D *texture){
+    static constexpr size_t ColorsChunk = 256;
+    u32 packed_colors[ColorsChunk];
+
+    SX_2D_STATS_TIMER(m_Stats.GenerationNanoseconds);
+    SX_2D_STATS(m_Stats.Primitives += count);
+
+    size_t submitted = 0;
+    while (submitted < count) {
+        Batch &batch = BatchFor({&texture, 1});
+        UploadArena &arena = m_Frames[m_CurrentFrame].Arena();
+
+        const u32 texture_index = TextureIndex(batch, texture);
+        const size_t batch_room = Math::Min(m_PrimitivesInBatch - batch.InstancesCount, QuadIndexBuffer::MaxQuadsCount - arena.Size);
+        const size_t batch_count = Math::Min(count - submitted, batch_room);
+
+        RectInstance *instances = arena.Push(batch_count);
+
+        for (size_t i = 0; i < batch_count; i += ColorsChunk) {
+            const size_t chunk = Math::Min(batch_count - i, ColorsChunk);
+            const size_t first = submitted + i;
+
+            PackColorsRGBA8(colors + first, packed_colors, chunk);
+
+            WriteInstances(instances + i, positions + first, sizes + first, angles ? angles + first : nullptr, packed_colors, chunk, texture_index);
+        }
+
+        batch.InstancesCount += batch_count;
+        submitted += batch_count;
+    }
+}
+
+void RectRenderer::WriteInstances(RectInstance *instances, const Vector2f *positions, const Vector2f *sizes, const float *angles, const u32 *colors, size_t count, u32 texture_index){
+#if SX_2D_SIMD_SSE2 && !SX_2D_COMPACT_INSTANCES
+    static_assert(offsetof(RectInstance, a_Size)         == 8
+               && offsetof(RectInstance, a_Origin)       == 16
+               && offsetof(RectInstance, a_TexCoordsMin) == 32
+               && offsetof(RectInstance, a_TexIndex)     == 48, "RectRenderer: WriteInstances relies on RectInstance layout");
+
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 tex_coords = _mm_setr_ps(0.f, 0.f, 1.f, 1.f);
+    const __m128i tex_index = _mm_cvtsi32_si128((int)texture_index);
+
+    for (size_t i = 0; i < count; i++) {
+        float *instance = (float *)(instances + i);
+
+        __m128 position = _mm_castpd_ps(_mm_load_sd((const double *)(positions + i)));
+        __m128 size     = _mm_castpd_ps(_mm_load_sd((const double *)(sizes + i)));
+        __m128 angle    = angles ? _mm_load_ss(angles + i) : _mm_setzero_ps();
+        __m128 color    = _mm_castsi128_ps(_mm_cvtsi32_si128((int)colors[i]));
+
+        _mm_storeu_ps(instance + 0, _mm_movelh_ps(position, size));
+        _mm_storeu_ps(instance + 4, _mm_movelh_ps(_mm_mul_ps(size, half), _mm_unpacklo_ps(angle, color)));
+        _mm_storeu_ps(instance + 8, tex_coords);
+        _mm_storel_epi64((__m128i *)(instance + 12), tex_index);
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+        instances[i] = RectInstance::Make(positions[i], sizes[i], sizes[i] / 2.f, angles ? angles[i] : 0.f, colors[i], {0.f, 0.f}, {1.f, 1.f}, texture_index);
+#endif
 }
 
 void RectRenderer::CmdRender(CommandBuffer* cmd_buffer, const Framebuffer* fb, const ViewportParameters& viewport) {
-    m_SetPool.NextFrame();
-    
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    frame.SetPool->NextFrame();
+    if (frame.BindlessSetPool)
+        frame.BindlessSetPool->NextFrame();
+
+    MergeRecorders();
+
+    if (m_Capture)
+        m_Capture->Boundary(DrawCommandType::RectRender, fb->Size(), viewport);
+
     const auto vp = viewport.ViewportSize;
     Matrix4f projection{
         {2.f / vp.x, 0,                0, 0},
@@ -156,24 +728,73 @@ void RectRenderer::CmdRender(CommandBuffer* cmd_buffer, const Framebuffer* fb, c
     cmd_buffer->SetViewport(0, 0, fb->Size().x, fb->Size().y);
 
     cmd_buffer->Copy({projection}, m_MatricesUniformBuffer);    
-    cmd_buffer->Bind(m_Pipeline.Get());
+    SX_2D_STATS(m_Stats.BytesUploaded += sizeof(projection));
+
+    for (size_t i = 0; i <= frame.CurrentChunk; i++) {
+        UploadArena &arena = *frame.Chunks[i];
+
+        ReserveDevice(arena);
+
+        if (arena.Size)
+            cmd_buffer->Copy(arena.Staging, arena.Device, arena.Size * sizeof(RectInstance));
+        SX_2D_STATS(m_Stats.BytesUploaded += arena.Size * sizeof(RectInstance));
+    }
+
+    const bool starts_bindless = m_Batches.Size() && m_Batches[0].IsBindless;
+    cmd_buffer->Bind(starts_bindless ? m_BindlessPipeline.Get() : m_Pipeline.Get());
     cmd_buffer->BeginRenderPass(m_FramebufferPass, fb);
+    bool is_bindless_bound = starts_bindless;
+    DescriptorSet *bindless_set = nullptr;
+    size_t bindless_chunk = -1;
     for (Batch& batch : m_Batches) {
-        auto* set = m_SetPool.Alloc();
-        batch.VertexBuffer->Copy(batch.Vertices.Get(), batch.VertexBuffer->Size());
-        batch.IndexBuffer->Copy(batch.Indices.Get(), batch.IndexBuffer->Size());
-        set->UpdateUniformBinding(0, 0, m_MatricesUniformBuffer);
-
-        for (size_t i = 0; i < batch.Textures.Size(); i++)
-            set->UpdateTextureBinding(1, i, batch.Textures[i], m_DefaultSampler.Get());
+        // a batch can be left empty when the table runs out right after it was started
+        if (!batch.InstancesCount)
+            continue;
+
+        const Buffer *instances = frame.Chunks[batch.Chunk]->Device;
+        DescriptorSet *set = nullptr;
+
+        if (batch.IsBindless != is_bindless_bound) {
+            cmd_buffer->Bind(batch.IsBindless ? m_BindlessPipeline.Get() : m_Pipeline.Get());
+            is_bindless_bound = batch.IsBindless;
+        }
+
+        if (batch.IsBindless) {
+            if (batch.Chunk != bindless_chunk) {
+                bindless_set = batch.Chunk ? WriteSpillBindlessSet(instances) : UpdateBindlessSet(instances);
+                bindless_chunk = batch.Chunk;
+            }
+            set = bindless_set;
+        } else {
+            set = AcquireBatchSet(batch, instances);
+        }
         
         cmd_buffer->Bind(set);
-        cmd_buffer->BindVertexBuffer(batch.VertexBuffer.Get());
-        cmd_buffer->BindIndexBuffer(batch.IndexBuffer.Get(), IndicesType::Uint16);
-        cmd_buffer->DrawIndexed(batch.SubmitedPrimitives * 6);
+        cmd_buffer->BindIndexBuffer(m_IndexBuffer, IndicesType::Uint32);
+        // quad indices of instance N are 4N..4N+3, so starting from FirstInstance makes shader fetch right records
+        cmd_buffer->DrawIndexed(batch.InstancesCount * 6, batch.FirstInstance * 6);
+
+        SX_2D_STATS(m_Stats.Batches++);
+        SX_2D_STATS(m_Stats.DrawCalls++);
     }
     cmd_buffer->EndRenderPass();
 
-    for (auto& batch : m_Batches)
-        batch.Reset();
+    m_LastFrameStats = m_Stats;
+    m_Stats = {};
+
+    m_Batches.Clear();
+
+    for (size_t i = 0; i <= frame.CurrentChunk; i++)
+        frame.Chunks[i]->PeakSize = Math::Max(frame.Chunks[i]->PeakSize, frame.Chunks[i]->Size);
+
+    m_FrameIndex++;
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+
+    Frame &next = m_Frames[m_CurrentFrame];
+    next.CurrentChunk = 0;
+    for (size_t i = 0; i < next.Chunks.Size(); i++) {
+        next.Chunks[i]->Reset();
+        // GPU is done with the next frame, so it's safe to release its memory
+        TrimArena(*next.Chunks[i], i ? 0 : m_ReservedPrimitives);
+    }
 }
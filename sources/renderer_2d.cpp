@@ -0,0 +1,133 @@
+#include "2d/renderer_2d.hpp"
+#include "2d/circle_renderer.hpp"
+#include "2d/line_renderer.hpp"
+#include "2d/common/view_uniform.hpp"
+#include "core/assert.hpp"
+#include "graphics/api/gpu.hpp"
+
+Renderer2D::Renderer2D(size_t frames_in_flight):
+    m_CmdPool(CommandPool::Create()),
+    m_Frames(new Frame[frames_in_flight]),
+    m_FramesCount(frames_in_flight)
+{
+    SX_CORE_ASSERT(frames_in_flight, "Renderer2D: at least one frame in flight is required");
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        m_Frames[i].CmdBuffer = m_CmdPool->Alloc();
+        m_Frames[i].DrawingFence.Signal();
+        m_Frames[i].ViewUniformBuffer = Buffer::Create(sizeof(ViewUniform), BufferMemoryType::DynamicVRAM, BufferUsageBits::UniformBuffer);
+    }
+}
+
+Renderer2D::~Renderer2D(){
+    // circles and lines would go on recording into a destroyed context otherwise
+    for(const Attachment &attachment: m_Attachments){
+        if(attachment.Detach)
+            attachment.Detach(attachment.Renderer);
+    }
+
+    for(size_t i = 0; i<m_FramesCount; i++){
+        m_Frames[i].DrawingFence.WaitFor();
+        m_CmdPool->Free(m_Frames[i].CmdBuffer);
+
+        delete m_Frames[i].ViewUniformBuffer;
+        for(SetPoolSlot &slot: m_Frames[i].SetPools)
+            delete slot.Pool;
+    }
+}
+
+void Renderer2D::Attach(CircleRenderer *renderer){
+    SX_CORE_ASSERT(!renderer->m_Context, "Renderer2D: CircleRenderer is already attached");
+    SX_CORE_ASSERT(renderer->m_FramesCount == m_FramesCount, "Renderer2D: attached renderer should have the same frames in flight");
+
+    renderer->m_Context = this;
+    renderer->DisableCulling();
+
+    RecordFunction record = [](void *object, Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+        static_cast<CircleRenderer *>(object)->CmdRender(context, cmd_buffer, fb, viewport);
+    };
+    DetachFunction detach = [](void *object){
+        static_cast<CircleRenderer *>(object)->m_Context = nullptr;
+    };
+    m_Attachments.Add({renderer, record, detach});
+}
+
+void Renderer2D::Attach(LineRenderer *renderer){
+    SX_CORE_ASSERT(!renderer->m_Context, "Renderer2D: LineRenderer is already attached");
+    SX_CORE_ASSERT(renderer->m_FramesCount == m_FramesCount, "Renderer2D: attached renderer should have the same frames in flight");
+
+    renderer->m_Context = this;
+    renderer->DisableCulling();
+
+    RecordFunction record = [](void *object, Renderer2D &context, CommandBuffer *cmd_buffer, const Framebuffer *fb, const ViewportParameters &viewport){
+        static_cast<LineRenderer *>(object)->CmdRender(context, cmd_buffer, fb, viewport);
+    };
+    DetachFunction detach = [](void *object){
+        static_cast<LineRenderer *>(object)->m_Context = nullptr;
+    };
+    m_Attachments.Add({renderer, record, detach});
+}
+
+void Renderer2D::Detach(void *renderer){
+    for(size_t i = 0; i<m_Attachments.Size(); i++){
+        if(m_Attachments[i].Renderer == renderer){
+            if(m_Attachments[i].Detach)
+                m_Attachments[i].Detach(renderer);
+
+            m_Attachments.RemoveAt(i);
+            return;
+        }
+    }
+}
+
+DescriptorSet *Renderer2D::AllocSet(const DescriptorSetLayout *layout){
+    SX_CORE_ASSERT(m_IsFrameBegun, "Renderer2D: descriptor sets are allocated between BeginFrame and EndFrame");
+
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    for(SetPoolSlot &slot: frame.SetPools){
+        if(slot.Layout == layout)
+            return slot.Pool->Alloc();
+    }
+
+    frame.SetPools.Add({layout, new SingleFrameDescriptorSetPool({MaxSetsPerLayout, layout}, 0)});
+    return frame.SetPools.Last().Pool->Alloc();
+}
+
+void Renderer2D::BeginFrame(){
+    SX_CORE_ASSERT(!m_IsFrameBegun, "Renderer2D: BeginFrame was called twice");
+
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    if(!frame.DrawingFence.IsSignaled())
+        m_FramesStats.RingExhausted++;
+    frame.DrawingFence.WaitAndReset();
+
+    // sets of the frame are not used by GPU anymore
+    for(SetPoolSlot &slot: frame.SetPools)
+        slot.Pool->NextFrame();
+
+    m_IsFrameBegun = true;
+}
+
+void Renderer2D::EndFrame(const Semaphore *wait_semaphore, const Semaphore *signal_semaphore, const Framebuffer *fb, const ViewportParameters &viewport){
+    SX_CORE_ASSERT(m_IsFrameBegun, "Renderer2D: EndFrame without BeginFrame");
+
+    Frame &frame = m_Frames[m_CurrentFrame];
+
+    const ViewUniform uniform = ViewUniform::Make(fb->Size(), viewport);
+    frame.ViewUniformBuffer->Copy(&uniform, sizeof(uniform));
+
+    frame.CmdBuffer->Reset();
+    frame.CmdBuffer->Begin();
+    for(const Attachment &attachment: m_Attachments)
+        attachment.Record(attachment.Renderer, *this, frame.CmdBuffer, fb, viewport);
+    frame.CmdBuffer->End();
+
+    GPU::Execute(frame.CmdBuffer, *wait_semaphore, *signal_semaphore, frame.DrawingFence);
+
+    m_FramesStats.SubmittedFrames++;
+
+    m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesCount;
+    m_IsFrameBegun = false;
+}
@@ -1,8 +1,7 @@
 R"(
     layout(location = 0)in vec4 v_Color;
-    layout(location = 1)in vec2 v_Position;
-    layout(location = 2)in vec2 v_Center;
-    layout(location = 3)in flat float v_Radius;
+    layout(location = 1)in vec2 v_Center;
+    layout(location = 2)in flat float v_Radius;
 
     layout(location = 0)out vec4 f_Color;
 
@@ -12,4 +11,4 @@ R"(
             discard;
         f_Color = v_Color;
     }
-)"
\ No newline at end of file
+)"
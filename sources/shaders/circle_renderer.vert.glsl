@@ -1,24 +1,45 @@
 R"(
-    layout(location = 0)in vec2 a_Position;
-    layout(location = 1)in vec2 a_Center;
-    layout(location = 2)in vec4 a_Color;
-    layout(location = 3)in float a_Radius;
+    struct CircleInstance{
+        vec2  Center;
+        float Radius;
+        uint  Color;
+    };
 
     layout(location = 0)out vec4 v_Color;
-    layout(location = 1)out vec2 v_Position;
-    layout(location = 2)out vec2 v_Center;
-    layout(location = 3)out flat float v_Radius;
+    layout(location = 1)out vec2 v_Center;
+    layout(location = 2)out flat float v_Radius;
 
     layout(std140, binding = 0)uniform MatricesUniform{
         mat4 u_Projection;
+        vec2 u_ViewScale;
+        vec2 u_ViewOffset;
+    };
+
+    layout(std430, binding = 1)readonly buffer CircleInstances{
+        CircleInstance u_Instances[];
     };
 
+    const vec2 s_Corners[6] = vec2[6](
+        vec2(-1.0,-1.0),
+        vec2( 1.0,-1.0),
+        vec2( 1.0, 1.0),
+
+        vec2( 1.0, 1.0),
+        vec2(-1.0, 1.0),
+        vec2(-1.0,-1.0)
+    );
+
     void main(){
-        gl_Position = u_Projection * vec4(a_Position.xy, 0.0, 1.0);
+        CircleInstance instance = u_Instances[gl_VertexIndex / 6];
+
+        vec2 local = s_Corners[gl_VertexIndex % 6] * instance.Radius;
+
+        vec2 center = instance.Center * u_ViewScale - u_ViewOffset;
+
+        gl_Position = u_Projection * vec4(center + local * u_ViewScale, 0.0, 1.0);
 
-        v_Color = a_Color;
-        v_Position = a_Position;
-        v_Center = a_Center;
-        v_Radius = a_Radius;
+        v_Color = unpackUnorm4x8(instance.Color);
+        v_Center = local;
+        v_Radius = instance.Radius;
     }
-)"
\ No newline at end of file
+)"
@@ -6,10 +6,12 @@ R"(
 
     layout(std140, binding = 0)uniform MatricesUniform{
         mat4 u_Projection;
+        vec2 u_ViewScale;
+        vec2 u_ViewOffset;
     };
 
     void main(){
-        gl_Position = u_Projection * vec4(a_Position.xy, 0.0, 1.0);
+        gl_Position = u_Projection * vec4((a_Position - u_ViewOffset) * u_ViewScale, 0.0, 1.0);
 
         v_Color = a_Color;
     }
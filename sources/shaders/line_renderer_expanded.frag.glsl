@@ -0,0 +1,17 @@
+R"(
+    layout(location = 0)in vec4 v_Color;
+    layout(location = 1)in vec2 v_Local;
+    layout(location = 2)in flat float v_Length;
+    layout(location = 3)in flat float v_HalfWidth;
+
+    layout(location = 0)out vec4 f_Color;
+
+    void main(){
+        // distance to the segment, always zero for miter joins
+        float along = max(max(-v_Local.x, v_Local.x - v_Length), 0.0);
+
+        if(length(vec2(along, v_Local.y)) > v_HalfWidth)
+            discard;
+        f_Color = v_Color;
+    }
+)"
@@ -0,0 +1,92 @@
+R"(
+    struct LineSegment{
+        vec2  First;
+        vec2  Last;
+        uint  PrevDirection;
+        uint  NextDirection;
+        // width in pixels in the low half, join in the high one
+        uint  WidthAndJoin;
+        uint  Color;
+    };
+
+    layout(location = 0)out vec4 v_Color;
+    layout(location = 1)out vec2 v_Local;
+    layout(location = 2)out flat float v_Length;
+    layout(location = 3)out flat float v_HalfWidth;
+
+    layout(std140, binding = 0)uniform MatricesUniform{
+        mat4 u_Projection;
+        vec2 u_ViewScale;
+        vec2 u_ViewOffset;
+    };
+
+    layout(std430, binding = 1)readonly buffer LineSegments{
+        LineSegment u_Segments[];
+    };
+
+    const uint c_MiterJoin = 0;
+    const uint c_RoundJoin = 1;
+
+    // x selects the endpoint, y is a side of the segment
+    const vec2 s_Corners[4] = vec2[4](
+        vec2(0.0,-1.0),
+        vec2(1.0,-1.0),
+        vec2(1.0, 1.0),
+        vec2(0.0, 1.0)
+    );
+
+    vec2 ToScreen(vec2 position){
+        return (position - u_ViewOffset) * u_ViewScale;
+    }
+
+    vec2 Normal(vec2 first, vec2 last){
+        vec2 direction = last - first;
+        float len = length(direction);
+        return len > 0.0 ? vec2(-direction.y, direction.x) / len : vec2(0.0, 1.0);
+    }
+
+    void main(){
+        LineSegment segment = u_Segments[gl_VertexIndex >> 2];
+        vec2 corner = s_Corners[gl_VertexIndex & 3];
+
+        vec2 first = ToScreen(segment.First);
+        vec2 last  = ToScreen(segment.Last);
+        float half_width = float(segment.WidthAndJoin & 0xFFFFu) * 0.5;
+        uint join = segment.WidthAndJoin >> 16;
+        float len = length(last - first);
+        vec2 normal = Normal(first, last);
+        vec2 direction = vec2(normal.y, -normal.x);
+
+        vec2 position;
+        if(join == c_RoundJoin){
+            // capsule around the segment, fragments outside of it are discarded
+            float along = corner.x == 0.0 ? -half_width : len + half_width;
+            position = first + direction * along + normal * corner.y * half_width;
+            v_Local = vec2(along, corner.y * half_width);
+        }else{
+            // endpoints are shifted along the bisector of adjacent normals, lone ends are flat
+            bool is_first = corner.x == 0.0;
+            vec2 endpoint = is_first ? first : last;
+            // direction is in world space, zero means there is no neighbour
+            vec2 neighbour_direction = unpackSnorm2x16(is_first ? segment.PrevDirection : segment.NextDirection);
+
+            vec2 other_normal = normal;
+            if(neighbour_direction != vec2(0.0))
+                other_normal = Normal(vec2(0.0), neighbour_direction * u_ViewScale);
+
+            vec2 miter = normal + other_normal;
+            miter = dot(miter, miter) > 0.0001 ? normalize(miter) : normal;
+            // sharp angles are limited to 4 half widths
+            float miter_length = half_width / max(dot(miter, normal), 0.25);
+
+            position = endpoint + miter * corner.y * miter_length;
+            v_Local = vec2(0.0, 0.0);
+        }
+
+        gl_Position = u_Projection * vec4(position, 0.0, 1.0);
+
+        v_Color = unpackUnorm4x8(segment.Color);
+        v_Length = len;
+        v_HalfWidth = half_width;
+    }
+)"
@@ -1,22 +1,48 @@
 R"(
-    layout(location = 0)in vec2 a_Position;
-    layout(location = 1)in vec2 a_TexCoords;
-    layout(location = 2)in vec4 a_Color;
-    layout(location = 3)in float a_TexIndex;
+    struct RectInstance{
+        vec2  Position;
+        vec2  Size;
+        vec2  Origin;
+        float Angle;
+        uint  Color;
+        vec2  TexCoordsMin;
+        vec2  TexCoordsMax;
+        uint  TexIndex;
+        uint  Padding;
+    };
 
     layout(location = 0)out vec4 v_Color;
     layout(location = 1)out vec2 v_TexCoords;
-    layout(location = 2)out flat float v_TexIndex;
+    layout(location = 2)out flat uint v_TexIndex;
 
     layout(std140, binding = 0)uniform MatricesUniform{
         mat4 u_Projection;
     };
 
+    layout(std430, binding = 2)readonly buffer RectInstances{
+        RectInstance u_Instances[];
+    };
+
+    const vec2 s_Corners[4] = vec2[4](
+        vec2(0.0, 0.0),
+        vec2(1.0, 0.0),
+        vec2(1.0, 1.0),
+        vec2(0.0, 1.0)
+    );
+
     void main(){
-        gl_Position = u_Projection * vec4(a_Position.xy, 0.0, 1.0);
+        RectInstance instance = u_Instances[gl_VertexIndex >> 2];
+        vec2 corner = s_Corners[gl_VertexIndex & 3];
+
+        float angle = radians(instance.Angle);
+        mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+        vec2 position = rotation * (corner * instance.Size - instance.Origin) + instance.Position;
+
+        gl_Position = u_Projection * vec4(position, 0.0, 1.0);
 
-        v_Color = a_Color;
-        v_TexCoords = a_TexCoords;
-        v_TexIndex = a_TexIndex;
+        v_Color = unpackUnorm4x8(instance.Color);
+        v_TexCoords = mix(instance.TexCoordsMin, instance.TexCoordsMax, corner);
+        v_TexIndex = instance.TexIndex;
     }
-)"
\ No newline at end of file
+)"
@@ -0,0 +1,16 @@
+R"(
+    #extension GL_EXT_nonuniform_qualifier : require
+
+    layout(location = 0)in vec4 v_Color;
+    layout(location = 1)in vec2 v_TexCoords;
+    layout(location = 2)in flat uint v_TexIndex;
+
+    layout(location = 0)out vec4 f_Color;
+
+    // sized by the set layout, which follows the device limit
+    layout(binding = 1)uniform sampler2D u_Textures[];
+
+    void main(){
+        f_Color = v_Color * texture(u_Textures[nonuniformEXT(v_TexIndex)], v_TexCoords);
+    }
+)"
@@ -0,0 +1,49 @@
+R"(
+    struct RectInstance{
+        vec2  Position;
+        uint  Size;
+        uint  Origin;
+        uint  AngleAndTexIndex;
+        uint  Color;
+        uint  TexCoordsMin;
+        uint  TexCoordsMax;
+    };
+
+    layout(location = 0)out vec4 v_Color;
+    layout(location = 1)out vec2 v_TexCoords;
+    layout(location = 2)out flat uint v_TexIndex;
+
+    layout(std140, binding = 0)uniform MatricesUniform{
+        mat4 u_Projection;
+    };
+
+    layout(std430, binding = 2)readonly buffer RectInstances{
+        RectInstance u_Instances[];
+    };
+
+    const vec2 s_Corners[4] = vec2[4](
+        vec2(0.0, 0.0),
+        vec2(1.0, 0.0),
+        vec2(1.0, 1.0),
+        vec2(0.0, 1.0)
+    );
+
+    void main(){
+        RectInstance instance = u_Instances[gl_VertexIndex >> 2];
+        vec2 corner = s_Corners[gl_VertexIndex & 3];
+
+        vec2 size   = unpackHalf2x16(instance.Size);
+        vec2 origin = unpackHalf2x16(instance.Origin);
+
+        float angle = float(instance.AngleAndTexIndex & 0xFFFFu) / 65536.0 * 6.28318530718;
+        mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+        vec2 position = rotation * (corner * size - origin) + instance.Position;
+
+        gl_Position = u_Projection * vec4(position, 0.0, 1.0);
+
+        v_Color = unpackUnorm4x8(instance.Color);
+        v_TexCoords = mix(unpackUnorm2x16(instance.TexCoordsMin), unpackUnorm2x16(instance.TexCoordsMax), corner);
+        v_TexIndex = instance.AngleAndTexIndex >> 16;
+    }
+)"
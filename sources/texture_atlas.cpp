@@ -0,0 +1,169 @@
+#include "2d/texture_atlas.hpp"
+#include "core/assert.hpp"
+#include "core/os/memory.hpp"
+
+TextureAtlas::Page::Page(u32 size):
+    Pixels(new u32[(size_t)size * size])
+{
+    Memory::Set(Pixels.Get(), 0, (size_t)size * size * sizeof(u32));
+
+    Skyline.Add({0, 0, size});
+
+    Texture = Texture2D::Create(size, size, TextureFormat::RGBA8, TextureUsageBits::Sampled | TextureUsageBits::TransferDst);
+}
+
+TextureAtlas::Page::~Page(){
+    delete Texture;
+}
+
+// finds the lowest position across the skyline, ties are broken by the narrowest segment
+bool TextureAtlas::Page::Pack(u32 size, u32 width, u32 height, u32 &x, u32 &y){
+    size_t best_index = -1;
+    u32 best_bottom = -1;
+    u32 best_width  = -1;
+
+    for(size_t i = 0; i<Skyline.Size(); i++){
+        const u32 node_x = Skyline[i].X;
+
+        if(node_x + width > size)
+            break;
+
+        u32 node_y = 0;
+        u32 remaining = width;
+        for(size_t j = i; remaining; j++){
+            node_y = Skyline[j].Y > node_y ? Skyline[j].Y : node_y;
+            remaining -= Skyline[j].Width < remaining ? Skyline[j].Width : remaining;
+        }
+
+        if(node_y + height > size)
+            continue;
+
+        if(node_y + height < best_bottom || (node_y + height == best_bottom && Skyline[i].Width < best_width)){
+            best_index  = i;
+            best_bottom = node_y + height;
+            best_width  = Skyline[i].Width;
+            x = node_x;
+            y = node_y;
+        }
+    }
+
+    if(best_index == -1)
+        return false;
+
+    Insert(best_index, x, y, width, height);
+    return true;
+}
+
+void TextureAtlas::Page::Insert(size_t index, u32 x, u32 y, u32 width, u32 height){
+    Skyline.Insert(index, {x, y + height, width});
+
+    // shrink or remove nodes covered by the new one
+    for(size_t i = index + 1; i < Skyline.Size();){
+        SkylineNode &previous = Skyline[i - 1];
+        SkylineNode &node = Skyline[i];
+
+        if(node.X >= previous.X + previous.Width)
+            break;
+
+        u32 shrink = previous.X + previous.Width - node.X;
+        if(node.Width <= shrink){
+            Skyline.RemoveAt(i);
+            continue;
+        }
+
+        node.X += shrink;
+        node.Width -= shrink;
+        break;
+    }
+
+    // merge neighbours at the same height
+    for(size_t i = 0; i + 1 < Skyline.Size();){
+        if(Skyline[i].Y == Skyline[i + 1].Y){
+            Skyline[i].Width += Skyline[i + 1].Width;
+            Skyline.RemoveAt(i + 1);
+        }else{
+            i++;
+        }
+    }
+}
+
+TextureAtlas::TextureAtlas(u32 page_size):
+    m_PageSize(page_size)
+{}
+
+TextureAtlas::~TextureAtlas(){
+    for(Page *page: m_Pages)
+        delete page;
+}
+
+AtlasRegion TextureAtlas::Add(u32 width, u32 height, const u32 *rgba8_pixels){
+    const u32 padded_width  = width  + Padding * 2;
+    const u32 padded_height = height + Padding * 2;
+
+    if(!width || !height || padded_width > m_PageSize || padded_height > m_PageSize)
+        return {};
+
+    u32 x = 0, y = 0;
+    Page *target = nullptr;
+
+    for(Page *page: m_Pages){
+        if(page->Pack(m_PageSize, padded_width, padded_height, x, y)){
+            target = page;
+            break;
+        }
+    }
+
+    if(!target){
+        target = new Page(m_PageSize);
+        m_Pages.Add(target);
+
+        bool packed = target->Pack(m_PageSize, padded_width, padded_height, x, y);
+        SX_CORE_ASSERT(packed, "TextureAtlas: Image should always fit into an empty page");
+        (void)packed;
+    }
+
+    u32 *pixels = target->Pixels.Get();
+    auto page_row = [&](u32 row){
+        return pixels + (size_t)(y + row) * m_PageSize + x;
+    };
+
+    // edge texels are extruded into the gutter, so filtering at the region's border samples its own colors
+    for(u32 row = 0; row < height; row++){
+        u32 *destination = page_row(Padding + row);
+        const u32 *source = rgba8_pixels + (size_t)row * width;
+
+        Memory::Copy(source, destination + Padding, width * sizeof(u32));
+
+        for(u32 i = 0; i < Padding; i++){
+            destination[i] = source[0];
+            destination[Padding + width + i] = source[width - 1];
+        }
+    }
+
+    for(u32 i = 0; i < Padding; i++){
+        Memory::Copy(page_row(Padding), page_row(i), padded_width * sizeof(u32));
+        Memory::Copy(page_row(Padding + height - 1), page_row(Padding + height + i), padded_width * sizeof(u32));
+    }
+
+    target->IsDirty = true;
+
+    const float page_size = (float)m_PageSize;
+    const Vector2f min((x + Padding) / page_size, (y + Padding) / page_size);
+    const Vector2f max((x + Padding + width) / page_size, (y + Padding + height) / page_size);
+
+    AtlasRegion region;
+    region.Page = target->Texture;
+    region.TexCoordsMin = min;
+    region.TexCoordsMax = max;
+    return region;
+}
+
+void TextureAtlas::Upload(){
+    for(Page *page: m_Pages){
+        if(!page->IsDirty)
+            continue;
+
+        page->Texture->Copy(page->Pixels.Get(), (size_t)m_PageSize * m_PageSize * sizeof(u32));
+        page->IsDirty = false;
+    }
+}